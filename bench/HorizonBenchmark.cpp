@@ -0,0 +1,161 @@
+//
+//  HorizonBenchmark.cpp
+//  LSCM
+//
+//  Times every level of HorizonKernels the CPU supports against the scalar
+//  kernels, over a horizon as wide as an atlas and a chart's bottom sliding
+//  along it, as the horizon search does, and checks each level returns what
+//  the scalar one does.
+//
+//  ./horizon_benchmark ([columns]) ([chart_columns]) ([repetitions])
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../src/packing/HorizonKernels.h"
+
+typedef std::chrono::steady_clock Clock;
+
+namespace
+{
+    struct Result
+    {
+        double maxSum;
+        double maxShifted;
+        double rest;
+
+        // Sum of every output, compared against the scalar kernels
+        double checksum;
+    };
+
+    double Seconds(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Result Run(const std::vector<float>& horizon, const std::vector<float>& bottom, size_t repetitions)
+    {
+        const auto n = bottom.size();
+        const auto count = horizon.size() - n;
+
+        Result result = {0, 0, 0, 0};
+
+        auto start = Clock::now();
+
+        for (size_t r = 0; r < repetitions; r++)
+        {
+            for (size_t x = 0; x < count; x++)
+            {
+                result.checksum += HorizonKernels::MaxSum(horizon.data() + x, bottom.data(), n, FLT_MIN);
+            }
+        }
+
+        result.maxSum = Seconds(start);
+
+        std::vector<float> bounds(count);
+
+        start = Clock::now();
+
+        for (size_t r = 0; r < repetitions; r++)
+        {
+            std::fill(bounds.begin(), bounds.end(), FLT_MIN);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                HorizonKernels::MaxShifted(bounds.data(), horizon.data() + i, bottom[i], count);
+            }
+        }
+
+        result.maxShifted = Seconds(start);
+
+        for (const auto bound : bounds)
+        {
+            result.checksum += bound;
+        }
+
+        std::vector<float> rested(horizon);
+
+        start = Clock::now();
+
+        for (size_t r = 0; r < repetitions; r++)
+        {
+            for (size_t x = 0; x < count; x += n)
+            {
+                HorizonKernels::Rest(rested.data() + x, bottom.data(), (float)r, n);
+            }
+        }
+
+        result.rest = Seconds(start);
+
+        for (const auto value : rested)
+        {
+            result.checksum += value;
+        }
+
+        return result;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const auto columns = argc > 1 ? (size_t)std::atol(argv[1]) : 2048;
+    const auto chartColumns = argc > 2 ? (size_t)std::atol(argv[2]) : 200;
+    const auto repetitions = argc > 3 ? (size_t)std::atol(argv[3]) : 20;
+
+    if (chartColumns == 0 || chartColumns >= columns)
+    {
+        std::cout << "chart_columns must be between 0 and columns" << std::endl;
+        exit(1);
+    }
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> heights(0.0f, 1.0f);
+
+    std::vector<float> horizon(columns);
+    std::vector<float> bottom(chartColumns);
+
+    for (auto& height : horizon)
+    {
+        height = heights(random);
+    }
+
+    for (auto& height : bottom)
+    {
+        height = heights(random);
+    }
+
+    const HorizonKernels::Level levels[] = {HorizonKernels::Level::Scalar, HorizonKernels::Level::AVX2, HorizonKernels::Level::AVX512};
+
+    Result scalar = {0, 0, 0, 0};
+
+    for (const auto level : levels)
+    {
+        std::cout << HorizonKernels::Name(level) << ":";
+
+        if (!HorizonKernels::Select(level))
+        {
+            std::cout << " not supported" << std::endl;
+            continue;
+        }
+
+        const auto result = Run(horizon, bottom, repetitions);
+
+        if (level == HorizonKernels::Level::Scalar)
+        {
+            scalar = result;
+        }
+
+        std::cout << " MaxSum " << result.maxSum << "s (" << scalar.maxSum / result.maxSum << "x)"
+            << " MaxShifted " << result.maxShifted << "s (" << scalar.maxShifted / result.maxShifted << "x)"
+            << " Rest " << result.rest << "s (" << scalar.rest / result.rest << "x)"
+            << (result.checksum == scalar.checksum ? "" : " *differs from scalar*") << std::endl;
+    }
+
+    return 0;
+}
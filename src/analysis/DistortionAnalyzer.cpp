@@ -0,0 +1,222 @@
+//
+//  DistortionAnalyzer.cpp
+//  LSCM
+//
+//  Referenced:
+//  Texture Mapping Progressive Meshes - Sander et al
+//  https://hhoppe.com/tmpm.pdf
+//
+//  Each chart's faces are gathered into flat arrays once, then measured in
+//  loops without branches so they vectorize. Charts are independent and
+//  analyzed in parallel.
+//
+
+#include "DistortionAnalyzer.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+DistortionAnalyzer::DistortionAnalyzer(const Mesh* mesh, const std::vector<Chart>* charts, const FaceFrames* frames)
+: _mesh(mesh)
+, _charts(charts)
+, _frames(frames)
+, _maxStretch(0)
+{
+}
+
+void DistortionAnalyzer::setGate(float maxStretch)
+{
+    _maxStretch = maxStretch;
+}
+
+void DistortionAnalyzer::analyze()
+{
+    std::cout << "Analyzing Distortion..." << std::endl;
+
+    const auto numCharts = (std::ptrdiff_t)_charts->size();
+
+    _distortions.resize(numCharts);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (std::ptrdiff_t i = 0; i < numCharts; i++)
+    {
+        analyze((*_charts)[i], _distortions[i]);
+    }
+
+    for (const auto& distortion : _distortions)
+    {
+        std::cout << "Chart: " << distortion.id << std::endl
+            << "\tStretch: " << distortion.stretchL2 << " (max " << distortion.stretchMax << ")" << std::endl
+            << "\tConformal: " << distortion.conformal << " (max " << distortion.conformalMax << ")" << std::endl
+            << "\tArea: " << distortion.area << " (max " << distortion.areaMax << ")" << std::endl
+            << "\tFlipped: " << distortion.flipped << std::endl;
+
+        if (distortion.flagged)
+        {
+            std::cout << "\t*Flagged" << std::endl;
+        }
+    }
+}
+
+const std::vector<ChartDistortion>& DistortionAnalyzer::distortions() const
+{
+    return _distortions;
+}
+
+std::vector<size_t> DistortionAnalyzer::flagged() const
+{
+    std::vector<size_t> ids;
+
+    for (const auto& distortion : _distortions)
+    {
+        if (distortion.flagged)
+        {
+            ids.push_back(distortion.id);
+        }
+    }
+
+    return ids;
+}
+
+void DistortionAnalyzer::analyze(const Chart& chart, ChartDistortion& distortion) const
+{
+    const auto& faces = chart.faces();
+    const auto& texCoords = chart.texCoords();
+    const auto numFaces = (std::ptrdiff_t)faces.size();
+
+    distortion = ChartDistortion();
+    distortion.id = chart.id();
+
+    // Frame of each face, its surface area and its UV edges from the first vertex
+    std::array<std::vector<float>, 8> data;
+
+    for (auto& values : data)
+    {
+        values.resize(numFaces);
+    }
+
+    auto* x1 = data[0].data();
+    auto* x2 = data[1].data();
+    auto* y2 = data[2].data();
+    auto* areas = data[3].data();
+    auto* u1 = data[4].data();
+    auto* v1 = data[5].data();
+    auto* u2 = data[6].data();
+    auto* v2 = data[7].data();
+
+    Mesh::Point pv[3];
+    Mesh::TexCoord2D uv[3];
+
+    for (auto f = 0; f < numFaces; f++)
+    {
+        auto i = 0;
+        auto fv_it = _mesh->cfv_begin(faces[f]), fv_end = _mesh->cfv_end(faces[f]);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            uv[i] = _mesh->property(texCoords, *fv_it);
+        }
+
+        _frames->project(faces[f], pv);
+
+        x1[f] = pv[1][0];
+        x2[f] = pv[2][0];
+        y2[f] = pv[2][1];
+        areas[f] = _frames->area(faces[f]);
+
+        u1[f] = uv[1][0] - uv[0][0];
+        v1[f] = uv[1][1] - uv[0][1];
+        u2[f] = uv[2][0] - uv[0][0];
+        v2[f] = uv[2][1] - uv[0][1];
+    }
+
+    auto surfaceArea = 0.0;
+    auto uvArea = 0.0;
+    auto signedArea = 0.0;
+
+    #pragma omp simd reduction(+:surfaceArea, uvArea, signedArea)
+    for (auto f = 0; f < numFaces; f++)
+    {
+        const auto cross = u1[f] * v2[f] - v1[f] * u2[f];
+
+        surfaceArea += areas[f];
+        uvArea += std::abs(cross) * 0.5f;
+        signedArea += cross * 0.5f;
+    }
+
+    if (uvArea <= 0 || surfaceArea <= 0)
+    {
+        distortion.flagged = _maxStretch > 0;
+        return;
+    }
+
+    // Scale the UVs to the surface area, and orient them like most of the chart
+    const auto scale = (float)std::sqrt(surfaceArea / uvArea);
+    const auto orientation = signedArea < 0 ? -1.0f : 1.0f;
+
+    auto stretch = 0.0;
+    auto stretchMax = 0.0f;
+    auto conformal = 0.0;
+    auto conformalMax = 0.0f;
+    auto area = 0.0;
+    auto areaMax = 0.0f;
+    auto flipped = 0;
+
+    #pragma omp simd reduction(+:stretch, conformal, area, flipped) reduction(max:stretchMax, conformalMax, areaMax)
+    for (auto f = 0; f < numFaces; f++)
+    {
+        // Faces without area have no frame to measure in, and would make
+        // every sum NaN, so they are measured as undistorted and weigh nothing
+        const auto valid = areas[f] > 0 && x1[f] > 0 && y2[f] > 0;
+        const auto weight = valid ? areas[f] : 0.0f;
+        const auto x = valid ? x1[f] : 1.0f;
+        const auto y = valid ? y2[f] : 1.0f;
+
+        // Partial derivatives of the UVs along the frame's axes
+        const auto ratio = valid ? x2[f] / x : 0.0f;
+
+        const auto su = valid ? u1[f] / x * scale : 1.0f;
+        const auto sv = valid ? v1[f] / x * scale : 0.0f;
+        const auto tu = valid ? (u2[f] - ratio * u1[f]) / y * scale : 0.0f;
+        const auto tv = valid ? (v2[f] - ratio * v1[f]) / y * scale : orientation;
+
+        const auto a = su * su + sv * sv;
+        const auto b = su * tu + sv * tv;
+        const auto c = tu * tu + tv * tv;
+        const auto det = (su * tv - sv * tu) * orientation;
+
+        const auto root = std::sqrt((a - c) * (a - c) + 4 * b * b);
+        const auto sigma1 = std::sqrt(std::max(0.0f, (a + c + root) * 0.5f));
+        const auto sigma2 = std::sqrt(std::max(0.0f, (a + c - root) * 0.5f));
+
+        // Stretch is measured from the UVs back to the surface, whose
+        // singular values are 1/σ2 and 1/σ1
+        const auto faceStretch = (a + c) / std::max(det * det, FLT_MIN) * 0.5f;
+        const auto faceConformal = sigma1 / std::max(sigma2, FLT_MIN);
+        const auto faceArea = std::max(std::abs(det), FLT_MIN);
+        const auto faceAreaRatio = std::max(faceArea, 1.0f / faceArea);
+
+        stretch += weight * faceStretch;
+        stretchMax = std::max(stretchMax, 1.0f / std::max(sigma2, FLT_MIN));
+
+        conformal += weight * faceConformal;
+        conformalMax = std::max(conformalMax, faceConformal);
+
+        area += weight * faceAreaRatio;
+        areaMax = std::max(areaMax, faceAreaRatio);
+
+        flipped += det < 0 ? 1 : 0;
+    }
+
+    distortion.stretchL2 = std::sqrt(stretch / surfaceArea);
+    distortion.stretchMax = stretchMax;
+    distortion.conformal = conformal / surfaceArea;
+    distortion.conformalMax = conformalMax;
+    distortion.area = area / surfaceArea;
+    distortion.areaMax = areaMax;
+    distortion.flipped = flipped;
+
+    distortion.flagged = _maxStretch > 0 && (distortion.stretchL2 > _maxStretch || distortion.flipped > 0);
+}
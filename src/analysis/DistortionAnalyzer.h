@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <vector>
+
+#include "../util/MeshDef.h"
+#include "../util/FaceFrames.h"
+
+#include "../charts/Chart.h"
+
+using namespace Charts;
+
+// Distortion of a chart's parameterization, measured from the singular
+// values σ1 >= σ2 of each face's Jacobian, from the surface to the UVs,
+// after the chart's UVs are scaled to the chart's surface area.
+struct ChartDistortion
+{
+    size_t id;
+
+    // Sander's L2 and L∞ stretch of the map from the UVs to the surface:
+    // the area weighted root mean square of 1/σ1 and 1/σ2, and the largest
+    // 1/σ2. Both are 1 for an isometry.
+    float stretchL2;
+    float stretchMax;
+
+    // Area weighted mean and maximum of σ1/σ2, 1 for a conformal map
+    float conformal;
+    float conformalMax;
+
+    // Area weighted mean and maximum of max(σ1σ2, 1/σ1σ2), 1 when the
+    // map preserves area
+    float area;
+    float areaMax;
+
+    // Faces oriented against the rest of the chart
+    size_t flipped;
+
+    bool flagged;
+};
+
+class DistortionAnalyzer
+{
+private:
+    const Mesh* _mesh;
+    const std::vector<Chart>* _charts;
+    const FaceFrames* _frames;
+
+    float _maxStretch;
+
+    std::vector<ChartDistortion> _distortions;
+
+public:
+    DistortionAnalyzer(const Mesh* mesh, const std::vector<Chart>* charts, const FaceFrames* frames);
+
+    // Flags charts whose L2 stretch is above maxStretch, or that have
+    // flipped faces, to be segmented again. A value of 0 disables it.
+    void setGate(float maxStretch);
+
+    void analyze();
+
+    const std::vector<ChartDistortion>& distortions() const;
+
+    // Ids of the flagged charts
+    std::vector<size_t> flagged() const;
+
+private:
+    void analyze(const Chart& chart, ChartDistortion& distortion) const;
+};
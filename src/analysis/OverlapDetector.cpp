@@ -0,0 +1,369 @@
+//
+//  OverlapDetector.cpp
+//  LSCM
+//
+//  Triangles are binned by their bounds into a grid of about one triangle
+//  per cell. A pair is tested only in the cell holding the lower corner of
+//  the intersection of their bounds, so every pair is tested once, by
+//  looking for a separating edge. The orientation tests run in double
+//  precision on the float UVs.
+//
+
+#include "OverlapDetector.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+// Grids above this many triangles are searched in parallel
+const size_t PARALLEL_TRIANGLES = 4096;
+
+// Upper bound on the cells per axis
+const size_t MAX_GRID_SIZE = 4096;
+
+static double Orient(const Mesh::TexCoord2D& a, const Mesh::TexCoord2D& b, const Mesh::TexCoord2D& c)
+{
+    return ((double)b[0] - a[0]) * ((double)c[1] - a[1]) - ((double)b[1] - a[1]) * ((double)c[0] - a[0]);
+}
+
+static int Sign(double value)
+{
+    return (value > 0) - (value < 0);
+}
+
+OverlapDetector::OverlapDetector(const Mesh* mesh, const std::vector<Chart>* charts)
+: _mesh(mesh)
+, _charts(charts)
+, _numCrossOverlaps(0)
+{
+}
+
+void OverlapDetector::detectCharts()
+{
+    std::cout << "Detecting Chart Overlaps..." << std::endl;
+
+    _chartOverlaps.resize(_charts->size());
+
+    std::vector<Triangle> triangles;
+    IndexPairs pairs;
+
+    Mesh::TexCoord2D uv[3];
+
+    for (auto c = 0; c < _charts->size(); c++)
+    {
+        const auto& chart = (*_charts)[c];
+        const auto& faces = chart.faces();
+        const auto& texCoords = chart.texCoords();
+
+        auto& result = _chartOverlaps[c];
+        result.id = chart.id();
+        result.flipped.clear();
+        result.overlaps.clear();
+
+        triangles.resize(faces.size());
+
+        auto signedArea = 0.0;
+
+        for (auto f = 0; f < faces.size(); f++)
+        {
+            auto i = 0;
+            auto fv_it = _mesh->cfv_begin(faces[f]), fv_end = _mesh->cfv_end(faces[f]);
+            for (; fv_it != fv_end; fv_it++, i++)
+            {
+                uv[i] = _mesh->property(texCoords, *fv_it);
+            }
+
+            triangles[f] = MakeTriangle(uv[0], uv[1], uv[2]);
+
+            signedArea += Orient(uv[0], uv[1], uv[2]);
+        }
+
+        // Flipped relative to how most of the chart is oriented
+        const auto orientation = Sign(signedArea);
+
+        for (auto f = 0; f < faces.size(); f++)
+        {
+            if (triangles[f].side != orientation)
+            {
+                result.flipped.push_back(faces[f]);
+            }
+        }
+
+        FindOverlaps(triangles, pairs);
+
+        for (const auto& pair : pairs)
+        {
+            result.overlaps.emplace_back(faces[pair.first], faces[pair.second]);
+        }
+
+        if (!result.flipped.empty() || !result.overlaps.empty())
+        {
+            std::cout << "Chart: " << result.id << std::endl
+                << "\tFlipped: " << result.flipped.size() << std::endl
+                << "\tOverlaps: " << result.overlaps.size() << std::endl;
+        }
+    }
+}
+
+void OverlapDetector::detectAtlas()
+{
+    std::cout << "Detecting Atlas Overlaps..." << std::endl;
+
+    std::vector<Triangle> triangles;
+    FaceList faces;
+    std::vector<size_t> faceCharts;
+
+    Mesh::TexCoord2D uv[3];
+
+    for (auto c = 0; c < _charts->size(); c++)
+    {
+        for (const auto& face : (*_charts)[c].faces())
+        {
+            auto i = 0;
+            auto fv_it = _mesh->cfv_begin(face), fv_end = _mesh->cfv_end(face);
+            for (; fv_it != fv_end; fv_it++, i++)
+            {
+                uv[i] = _mesh->texcoord2D(*fv_it);
+            }
+
+            triangles.push_back(MakeTriangle(uv[0], uv[1], uv[2]));
+            faces.push_back(face);
+            faceCharts.push_back(c);
+        }
+    }
+
+    IndexPairs pairs;
+    FindOverlaps(triangles, pairs);
+
+    _atlasOverlaps.clear();
+    _numCrossOverlaps = 0;
+
+    for (const auto& pair : pairs)
+    {
+        _atlasOverlaps.emplace_back(faces[pair.first], faces[pair.second]);
+
+        if (faceCharts[pair.first] != faceCharts[pair.second])
+        {
+            _numCrossOverlaps++;
+        }
+    }
+
+    std::cout << "\tOverlaps: " << _atlasOverlaps.size() << std::endl;
+}
+
+const std::vector<ChartOverlaps>& OverlapDetector::chartOverlaps() const
+{
+    return _chartOverlaps;
+}
+
+const std::vector<FacePair>& OverlapDetector::atlasOverlaps() const
+{
+    return _atlasOverlaps;
+}
+
+size_t OverlapDetector::numFlipped() const
+{
+    size_t count = 0;
+
+    for (const auto& result : _chartOverlaps)
+    {
+        count += result.flipped.size();
+    }
+
+    return count;
+}
+
+size_t OverlapDetector::numOverlaps() const
+{
+    // Without the chart pass, the atlas pass counts pairs within charts too
+    if (_chartOverlaps.empty())
+    {
+        return _atlasOverlaps.size();
+    }
+
+    size_t count = _numCrossOverlaps;
+
+    for (const auto& result : _chartOverlaps)
+    {
+        count += result.overlaps.size();
+    }
+
+    return count;
+}
+
+OverlapDetector::Triangle OverlapDetector::MakeTriangle(const Mesh::TexCoord2D& a, const Mesh::TexCoord2D& b, const Mesh::TexCoord2D& c)
+{
+    Triangle triangle;
+
+    triangle.p[0] = a;
+    triangle.p[1] = b;
+    triangle.p[2] = c;
+
+    triangle.min = a;
+    triangle.min.minimize(b);
+    triangle.min.minimize(c);
+
+    triangle.max = a;
+    triangle.max.maximize(b);
+    triangle.max.maximize(c);
+
+    triangle.side = Sign(Orient(a, b, c));
+
+    return triangle;
+}
+
+void OverlapDetector::FindOverlaps(const std::vector<Triangle>& triangles, IndexPairs& pairs)
+{
+    pairs.clear();
+
+    const auto numTriangles = triangles.size();
+
+    if (numTriangles < 2)
+    {
+        return;
+    }
+
+    auto min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
+    auto max = Mesh::TexCoord2D(-FLT_MAX, -FLT_MAX);
+
+    for (const auto& triangle : triangles)
+    {
+        min.minimize(triangle.min);
+        max.maximize(triangle.max);
+    }
+
+    const auto extent = max - min;
+    const auto cellSize = std::max(std::sqrt(extent[0] * extent[1] / numTriangles), std::max(extent[0], extent[1]) / MAX_GRID_SIZE);
+
+    if (!(cellSize > 0))
+    {
+        return;
+    }
+
+    const auto width = std::min(MAX_GRID_SIZE, (size_t)(extent[0] / cellSize) + 1);
+    const auto height = std::min(MAX_GRID_SIZE, (size_t)(extent[1] / cellSize) + 1);
+
+    const auto cell = [&](float value, float origin, size_t size)
+    {
+        return std::min(size - 1, (size_t)std::max(0.0f, (value - origin) / cellSize));
+    };
+
+    // Cells hold the triangles whose bounds touch them, counted then filled
+    std::vector<size_t> offsets(width * height + 1, 0);
+
+    for (const auto& triangle : triangles)
+    {
+        for (auto y = cell(triangle.min[1], min[1], height); y <= cell(triangle.max[1], min[1], height); y++)
+        {
+            for (auto x = cell(triangle.min[0], min[0], width); x <= cell(triangle.max[0], min[0], width); x++)
+            {
+                offsets[y * width + x + 1]++;
+            }
+        }
+    }
+
+    for (auto i = 0; i < width * height; i++)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    std::vector<size_t> cells(offsets.back());
+
+    for (auto t = 0; t < numTriangles; t++)
+    {
+        const auto& triangle = triangles[t];
+
+        for (auto y = cell(triangle.min[1], min[1], height); y <= cell(triangle.max[1], min[1], height); y++)
+        {
+            for (auto x = cell(triangle.min[0], min[0], width); x <= cell(triangle.max[0], min[0], width); x++)
+            {
+                cells[next[y * width + x]++] = t;
+            }
+        }
+    }
+
+    #pragma omp parallel if (numTriangles > PARALLEL_TRIANGLES)
+    {
+        IndexPairs found;
+
+        #pragma omp for schedule(dynamic, 256)
+        for (std::ptrdiff_t t = 0; t < (std::ptrdiff_t)numTriangles; t++)
+        {
+            const auto& a = triangles[t];
+
+            for (auto y = cell(a.min[1], min[1], height); y <= cell(a.max[1], min[1], height); y++)
+            {
+                for (auto x = cell(a.min[0], min[0], width); x <= cell(a.max[0], min[0], width); x++)
+                {
+                    const auto c = y * width + x;
+
+                    for (auto k = offsets[c]; k < offsets[c + 1]; k++)
+                    {
+                        const auto u = cells[k];
+
+                        if (u <= t)
+                        {
+                            continue;
+                        }
+
+                        const auto& b = triangles[u];
+
+                        if (b.min[0] > a.max[0] || b.max[0] < a.min[0] || b.min[1] > a.max[1] || b.max[1] < a.min[1])
+                        {
+                            continue;
+                        }
+
+                        // Only test the pair in the cell of its lower shared corner
+                        if (cell(std::max(a.min[0], b.min[0]), min[0], width) != x || cell(std::max(a.min[1], b.min[1]), min[1], height) != y)
+                        {
+                            continue;
+                        }
+
+                        if (Overlap(a, b))
+                        {
+                            found.emplace_back(t, u);
+                        }
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        pairs.insert(pairs.end(), found.begin(), found.end());
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+// Two triangles' interiors are disjoint when the line through one of
+// their edges separates them, with the other triangle on or outside it.
+// Triangles that only share edges or vertices do not overlap.
+bool OverlapDetector::Overlap(const Triangle& a, const Triangle& b)
+{
+    if (a.side == 0 || b.side == 0)
+    {
+        return false;
+    }
+
+    const auto separates = [](const Triangle& t, const Triangle& other)
+    {
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto& p = t.p[i];
+            const auto& q = t.p[(i + 1) % 3];
+
+            if (Sign(Orient(p, q, other.p[0])) * t.side <= 0 &&
+                Sign(Orient(p, q, other.p[1])) * t.side <= 0 &&
+                Sign(Orient(p, q, other.p[2])) * t.side <= 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    return !separates(a, b) && !separates(b, a);
+}
@@ -0,0 +1,77 @@
+
+#pragma once
+
+#include <vector>
+
+#include "../util/MeshDef.h"
+
+#include "../charts/Chart.h"
+
+using namespace Charts;
+
+typedef std::pair<Mesh::FaceHandle, Mesh::FaceHandle> FacePair;
+
+struct ChartOverlaps
+{
+    size_t id;
+
+    // Faces oriented against the rest of the chart, or with no UV area
+    FaceList flipped;
+
+    // Faces whose UV triangles overlap, beyond sharing edges or vertices
+    std::vector<FacePair> overlaps;
+};
+
+// Finds flipped and overlapping UV triangles, within each chart after
+// parameterization and across the whole atlas after packing. Triangles are
+// binned into a uniform grid and only pairs sharing a cell are tested.
+class OverlapDetector
+{
+private:
+    struct Triangle
+    {
+        Mesh::TexCoord2D p[3];
+        Mesh::TexCoord2D min;
+        Mesh::TexCoord2D max;
+
+        // Sign of the UV area, 0 for a degenerate triangle
+        int side;
+    };
+
+    typedef std::vector<std::pair<size_t, size_t>> IndexPairs;
+
+    const Mesh* _mesh;
+    const std::vector<Chart>* _charts;
+
+    std::vector<ChartOverlaps> _chartOverlaps;
+    std::vector<FacePair> _atlasOverlaps;
+
+    // Atlas overlaps between faces of different charts, the others are
+    // already counted by their chart
+    size_t _numCrossOverlaps;
+
+public:
+    OverlapDetector(const Mesh* mesh, const std::vector<Chart>* charts);
+
+    // Checks each chart's own UVs, as stored by the Parameterizer
+    void detectCharts();
+
+    // Checks the mesh's UVs across all charts, as applied by the Packer
+    void detectAtlas();
+
+    const std::vector<ChartOverlaps>& chartOverlaps() const;
+    const std::vector<FacePair>& atlasOverlaps() const;
+
+    size_t numFlipped() const;
+
+    // Each overlapping pair once, whether found within a chart, across the
+    // atlas, or both
+    size_t numOverlaps() const;
+
+private:
+    static Triangle MakeTriangle(const Mesh::TexCoord2D& a, const Mesh::TexCoord2D& b, const Mesh::TexCoord2D& c);
+
+    static void FindOverlaps(const std::vector<Triangle>& triangles, IndexPairs& pairs);
+
+    static bool Overlap(const Triangle& a, const Triangle& b);
+};
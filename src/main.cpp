@@ -6,12 +6,17 @@
 //  Copyright © 2020 Kyle. All rights reserved.
 //
 
+#include <fstream>
 #include <iostream>
+#include <memory>
 
 #include "features/FeatureBuilder.h"
 #include "charts/ChartBuilder.h"
 #include "parameterize/Parameterizer.h"
+#include "parameterize/ARAPRefiner.h"
 #include "packing/Packer.h"
+#include "analysis/DistortionAnalyzer.h"
+#include "analysis/OverlapDetector.h"
 
 #include "util/MeshUtil.h"
 #include "util/VizUtil.h"
@@ -29,7 +34,33 @@ int main(int argc, char * argv[])
             ("v,viz", "Path to save visualizations", cxxopts::value<std::string>())
             ("r,resolution", "Resolution of packing texture", cxxopts::value<size_t>())
             ("p,padding", "Padding between charts", cxxopts::value<size_t>())
+            ("orientation", "How charts are turned before packing: diameter, area or height", cxxopts::value<std::string>())
+            ("turns", "Also pack each chart in its other quarter turns, keeping the one wasting the least space", cxxopts::value<bool>())
+            ("mirror", "Also pack each chart mirrored, keeping the one wasting the least space", cxxopts::value<bool>())
+            ("engine", "How charts are packed: horizon, or occupancy to fill holes between charts", cxxopts::value<std::string>())
+            ("density", "Pack at this many texels per unit onto as many UDIM pages of the resolution as needed", cxxopts::value<float>())
+            ("order", "Order charts are packed in: height, area, perimeter or side", cxxopts::value<std::string>())
+            ("score", "How the horizon engine picks where a chart goes: waste, skyline or contact", cxxopts::value<std::string>())
+            ("portfolio", "Pack with every order and score at once, keeping the atlas with the best utilization", cxxopts::value<bool>())
+            ("portfolio-budget", "Seconds the portfolio may take before giving up on packs still running", cxxopts::value<double>())
+            ("layout", "Path of a layout saved before, whose charts are kept where they are while new charts are packed around them", cxxopts::value<std::string>())
+            ("save-layout", "Path to save the packed layout, for packing new charts around it later", cxxopts::value<std::string>())
             ("val", "Validate output", cxxopts::value<bool>())
+            ("texel-tolerance", "Stop the multilevel solve of a chart once vertices move less than this many texels, needs --multilevel", cxxopts::value<float>())
+            ("reorder", "Order chart unknowns for memory locality (default true)", cxxopts::value<bool>())
+            ("matrix-free", "Solve charts without assembling the sparse system", cxxopts::value<bool>())
+            ("multilevel", "Solve charts with at least this many faces coarse-to-fine", cxxopts::value<size_t>())
+            ("multilevel-tolerance", "UV tolerance of the multilevel solver, relative to the chart size", cxxopts::value<float>())
+            ("budget", "Seconds each chart's iterative solve may take before falling back", cxxopts::value<double>())
+            ("max-iterations", "Iterations each chart's iterative solve may take before falling back", cxxopts::value<size_t>())
+            ("result-cache", "Directory of previously solved charts, reused when their geometry matches exactly and they were solved with the same engine and solver options", cxxopts::value<std::string>())
+            ("topology-cache", "Directory of chart sparsity patterns, reused when a chart's faces and vertices match exactly", cxxopts::value<std::string>())
+            ("solve-report", "Path to save how each chart was solved, as CSV", cxxopts::value<std::string>())
+            ("max-stretch", "Flag charts with more L2 stretch than this, or with flipped faces", cxxopts::value<float>())
+            ("mixed-precision", "Run the multilevel preconditioner in single precision, needs --multilevel", cxxopts::value<bool>())
+            ("spectral", "Solve charts with the free-boundary spectral engine instead of LSCM", cxxopts::value<bool>())
+            ("spectral-charts", "Ids of charts to solve with the spectral engine", cxxopts::value<std::vector<size_t>>())
+            ("arap", "Refine charts with up to this many as-rigid-as-possible iterations", cxxopts::value<size_t>())
             ;
 
     std::string inputPath;
@@ -37,8 +68,34 @@ int main(int argc, char * argv[])
     std::string vizPath;
     size_t resolution = 2048;
     size_t padding = 4;
+    auto orientation = Packer::Orientation::Diameter;
+    bool turns = false;
+    bool mirror = false;
+    auto engine = Packer::Engine::Horizon;
+    float density = 0;
+    auto order = Packer::Order::Height;
+    auto score = Packer::Score::WastedSpace;
+    bool portfolio = false;
+    double portfolioBudget = 0;
+    std::string layoutPath;
+    std::string saveLayoutPath;
     std::stringstream path;
     bool validate = false;
+    float texelTolerance = 0;
+    bool matrixFree = false;
+    bool reorder = true;
+    size_t multilevelFaces = 0;
+    float multilevelTolerance = 0.001f;
+    bool mixedPrecision = false;
+    float maxStretch = 0;
+    double budget = 0;
+    size_t maxIterations = 0;
+    std::string solveReportPath;
+    std::string resultCachePath;
+    std::string topologyCachePath;
+    bool spectral = false;
+    std::vector<size_t> spectralCharts;
+    size_t arapIterations = 0;
 
     try
     {
@@ -68,10 +125,238 @@ int main(int argc, char * argv[])
             padding = result["padding"].as<size_t>();
         }
 
+        if (result.count("orientation"))
+        {
+            const auto name = result["orientation"].as<std::string>();
+
+            if (name == "diameter")
+            {
+                orientation = Packer::Orientation::Diameter;
+            }
+            else if (name == "area")
+            {
+                orientation = Packer::Orientation::MinArea;
+            }
+            else if (name == "height")
+            {
+                orientation = Packer::Orientation::MinHeight;
+            }
+            else
+            {
+                std::cout << "error parsing options: unknown orientation " << name << std::endl;
+                exit(1);
+            }
+        }
+
+        if (result.count("turns"))
+        {
+            turns = result["turns"].as<bool>();
+        }
+
+        if (result.count("mirror"))
+        {
+            mirror = result["mirror"].as<bool>();
+        }
+
+        if (result.count("engine"))
+        {
+            const auto name = result["engine"].as<std::string>();
+
+            if (name == "horizon")
+            {
+                engine = Packer::Engine::Horizon;
+            }
+            else if (name == "occupancy")
+            {
+                engine = Packer::Engine::Occupancy;
+            }
+            else
+            {
+                std::cout << "error parsing options: unknown engine " << name << std::endl;
+                exit(1);
+            }
+        }
+
+        if (result.count("density"))
+        {
+            density = result["density"].as<float>();
+        }
+
+        if (result.count("order"))
+        {
+            const auto name = result["order"].as<std::string>();
+
+            if (name == "height")
+            {
+                order = Packer::Order::Height;
+            }
+            else if (name == "area")
+            {
+                order = Packer::Order::Area;
+            }
+            else if (name == "perimeter")
+            {
+                order = Packer::Order::Perimeter;
+            }
+            else if (name == "side")
+            {
+                order = Packer::Order::MaxSide;
+            }
+            else
+            {
+                std::cout << "error parsing options: unknown order " << name << std::endl;
+                exit(1);
+            }
+        }
+
+        if (result.count("score"))
+        {
+            const auto name = result["score"].as<std::string>();
+
+            if (name == "waste")
+            {
+                score = Packer::Score::WastedSpace;
+            }
+            else if (name == "skyline")
+            {
+                score = Packer::Score::LowestSkyline;
+            }
+            else if (name == "contact")
+            {
+                score = Packer::Score::Contact;
+            }
+            else
+            {
+                std::cout << "error parsing options: unknown score " << name << std::endl;
+                exit(1);
+            }
+        }
+
+        if (result.count("portfolio"))
+        {
+            portfolio = result["portfolio"].as<bool>();
+        }
+
+        if (result.count("portfolio-budget"))
+        {
+            portfolioBudget = result["portfolio-budget"].as<double>();
+        }
+
+        if (result.count("layout"))
+        {
+            layoutPath = result["layout"].as<std::string>();
+        }
+
+        if (result.count("save-layout"))
+        {
+            saveLayoutPath = result["save-layout"].as<std::string>();
+        }
+
+        if (density > 0 && engine != Packer::Engine::Horizon)
+        {
+            std::cout << "error parsing options: pages are only packed by the horizon engine" << std::endl;
+            exit(1);
+        }
+
+        if (portfolio && (density > 0 || result.count("layout")))
+        {
+            std::cout << "error parsing options: the portfolio only packs a single atlas" << std::endl;
+            exit(1);
+        }
+
         if (result.count("val"))
         {
             validate = result["val"].as<bool>();
         }
+
+        if (result.count("texel-tolerance"))
+        {
+            texelTolerance = result["texel-tolerance"].as<float>();
+        }
+
+        if (result.count("reorder"))
+        {
+            reorder = result["reorder"].as<bool>();
+        }
+
+        if (result.count("matrix-free"))
+        {
+            matrixFree = result["matrix-free"].as<bool>();
+        }
+
+        if (result.count("multilevel"))
+        {
+            multilevelFaces = result["multilevel"].as<size_t>();
+        }
+
+        if (result.count("multilevel-tolerance"))
+        {
+            multilevelTolerance = result["multilevel-tolerance"].as<float>();
+        }
+
+        if (result.count("budget"))
+        {
+            budget = result["budget"].as<double>();
+        }
+
+        if (result.count("max-iterations"))
+        {
+            maxIterations = result["max-iterations"].as<size_t>();
+        }
+
+        if (result.count("solve-report"))
+        {
+            solveReportPath = result["solve-report"].as<std::string>();
+        }
+
+        if (result.count("result-cache"))
+        {
+            resultCachePath = result["result-cache"].as<std::string>();
+        }
+
+        if (result.count("topology-cache"))
+        {
+            topologyCachePath = result["topology-cache"].as<std::string>();
+        }
+
+        if (result.count("max-stretch"))
+        {
+            maxStretch = result["max-stretch"].as<float>();
+        }
+
+        if (result.count("mixed-precision"))
+        {
+            mixedPrecision = result["mixed-precision"].as<bool>();
+        }
+
+        if (result.count("spectral"))
+        {
+            spectral = result["spectral"].as<bool>();
+        }
+
+        if (result.count("spectral-charts"))
+        {
+            spectralCharts = result["spectral-charts"].as<std::vector<size_t>>();
+        }
+
+        if (result.count("arap"))
+        {
+            arapIterations = result["arap"].as<size_t>();
+        }
+
+        // Only the multilevel solver measures how far vertices still move,
+        // and only its preconditioner runs in single precision
+        if (texelTolerance > 0 && multilevelFaces == 0)
+        {
+            std::cout << "error parsing options: --texel-tolerance only applies with --multilevel" << std::endl;
+            exit(1);
+        }
+
+        if (mixedPrecision && multilevelFaces == 0)
+        {
+            std::cout << "error parsing options: --mixed-precision only applies with --multilevel" << std::endl;
+            exit(1);
+        }
     }
     catch (const cxxopts::OptionException& e)
     {
@@ -129,10 +414,88 @@ int main(int argc, char * argv[])
 
     Parameterizer param(mesh.get(), &chartBuilder.charts());
 
+    std::unique_ptr<ResultCache> resultCache;
+
+    if (!resultCachePath.empty())
+    {
+        resultCache = std::make_unique<ResultCache>(resultCachePath);
+        param.setResultCache(resultCache.get());
+    }
+
+    std::unique_ptr<TopologyCache> topologyCache;
+
+    if (!topologyCachePath.empty())
+    {
+        topologyCache = std::make_unique<TopologyCache>(topologyCachePath);
+        param.setTopologyCache(topologyCache.get());
+    }
+
+    if (texelTolerance > 0)
+    {
+        param.setTexelTolerance(resolution, texelTolerance);
+    }
+
+    param.setMatrixFree(matrixFree);
+    param.setReordering(reorder);
+    param.setMultilevel(multilevelFaces, 1, multilevelTolerance);
+    param.setMixedPrecision(mixedPrecision);
+    param.setBudget(budget, maxIterations);
+    param.setEngine(spectral ? Parameterizer::Engine::Spectral : Parameterizer::Engine::LSCM);
+
+    for (const auto id : spectralCharts)
+    {
+        param.setEngine(id, Parameterizer::Engine::Spectral);
+    }
+
     param.build();
 
     TIMER_END(Parameterization);
 
+    if (!solveReportPath.empty())
+    {
+        std::ofstream report(solveReportPath);
+        SolveReport::WriteCSV(report, param.reports());
+    }
+
+
+    if (arapIterations > 0)
+    {
+        TIMER_START(Refinement);
+
+        ARAPRefiner refiner(mesh.get(), &chartBuilder.charts(), &param.faceFrames());
+        refiner.setIterations(arapIterations);
+
+        refiner.refine();
+
+        TIMER_END(Refinement);
+    }
+
+
+    TIMER_START(Analysis);
+
+    DistortionAnalyzer analyzer(mesh.get(), &chartBuilder.charts(), &param.faceFrames());
+    analyzer.setGate(maxStretch);
+
+    analyzer.analyze();
+
+    TIMER_END(Analysis);
+
+    const auto flagged = analyzer.flagged();
+
+    if (!flagged.empty())
+    {
+        std::cerr << "*" << flagged.size() << " charts flagged for segmentation" << std::endl;
+    }
+
+
+    TIMER_START(ChartOverlaps);
+
+    OverlapDetector overlapDetector(mesh.get(), &chartBuilder.charts());
+
+    overlapDetector.detectCharts();
+
+    TIMER_END(ChartOverlaps);
+
 
     if (!vizPath.empty())
     {
@@ -148,11 +511,46 @@ int main(int argc, char * argv[])
     TIMER_START(Packing);
 
     Packer packer(mesh.get(), &chartBuilder.charts(), resolution, padding);
+    packer.setFaceFrames(&param.faceFrames());
+    packer.setEngine(engine);
+    packer.setOrientation(orientation);
+    packer.setTurns(turns, mirror);
+    packer.setPages(density);
+    packer.setOrder(order);
+    packer.setScore(score);
+    packer.setPortfolio(portfolio, portfolioBudget);
+
+    PackingLayout layout;
+
+    if (!layoutPath.empty())
+    {
+        if (!PackingLayout::Read(layoutPath, layout))
+        {
+            std::cerr << "*Failed to read layout " << layoutPath << std::endl;
+            return 1;
+        }
 
-    packer.pack();
+        packer.setLayout(&layout);
+    }
+
+    const auto packed = packer.pack();
 
     TIMER_END(Packing);
 
+    // New charts that did not fit would overlap the ones kept
+    if (!packed && !layoutPath.empty())
+    {
+        std::cerr << "*Failed to pack around the layout" << std::endl;
+        return 1;
+    }
+
+    // Charts left off the pages have no position, their UVs would be garbage
+    if (!packed && density > 0)
+    {
+        std::cerr << "*Failed to pack the charts onto pages of the resolution" << std::endl;
+        return 1;
+    }
+
 
     if (!vizPath.empty())
     {
@@ -162,9 +560,12 @@ int main(int argc, char * argv[])
             path << vizPath << "/chart-modified-" << chart.id() << ".bmp";
             VizUtil::DrawChart(path.str(), mesh, chart);
 
-            path.str("");
-            path << vizPath << "/chart-horizons-" << chart.id() << ".bmp";
-            VizUtil::DrawChartHorizons(path.str(), packer.packingChart(chart.id()));
+            if (engine == Packer::Engine::Horizon)
+            {
+                path.str("");
+                path << vizPath << "/chart-horizons-" << chart.id() << ".bmp";
+                VizUtil::DrawChartHorizons(path.str(), packer.packingChart(chart.id()));
+            }
         }
     }
 
@@ -175,16 +576,73 @@ int main(int argc, char * argv[])
 
     TIMER_END(Apply);
 
+    if (!saveLayoutPath.empty() && !PackingLayout::Write(saveLayoutPath, packer.layout()))
+    {
+        std::cerr << "*Failed to save layout " << saveLayoutPath << std::endl;
+    }
+
+
+    TIMER_START(AtlasOverlaps);
+
+    overlapDetector.detectAtlas();
+
+    TIMER_END(AtlasOverlaps);
+
+    if (validate && (overlapDetector.numFlipped() > 0 || overlapDetector.numOverlaps() > 0))
+    {
+        std::cerr << "*Validation failed: " << overlapDetector.numFlipped() << " flipped faces, " << overlapDetector.numOverlaps() << " overlaps" << std::endl;
+        return 1;
+    }
+
 
     if (!vizPath.empty())
     {
-        path.str("");
-        path << vizPath << "/atlas-horizons.bmp";
-        VizUtil::DrawAtlasHorizons(path.str(), packer.atlas(), packer.packingCharts());
+        if (engine == Packer::Engine::Occupancy)
+        {
+            path.str("");
+            path << vizPath << "/atlas-occupancy.bmp";
+            VizUtil::DrawOccupancy(path.str(), packer.occupancyAtlas().occupancy());
+        }
+        else if (packer.pages().empty())
+        {
+            // Charts kept from a layout were never placed on this horizon
+            std::vector<PackingChart> placedCharts;
 
-        path.str("");
-        path << vizPath << "/atlas-horizon.bmp";
-        VizUtil::DrawHorizon(path.str(), packer.atlas().horizon());
+            std::copy_if(
+                packer.packingCharts().begin(),
+                packer.packingCharts().end(),
+                std::back_inserter(placedCharts),
+                [&packer](const PackingChart& chart) { return !packer.kept(chart.chart()->id()); }
+            );
+
+            path.str("");
+            path << vizPath << "/atlas-horizons.bmp";
+            VizUtil::DrawAtlasHorizons(path.str(), packer.atlas(), placedCharts);
+
+            path.str("");
+            path << vizPath << "/atlas-horizon.bmp";
+            VizUtil::DrawHorizon(path.str(), packer.atlas().horizon());
+        }
+
+        for (size_t i = 0; i < packer.pages().size(); i++)
+        {
+            std::vector<PackingChart> pageCharts;
+
+            std::copy_if(
+                packer.packingCharts().begin(),
+                packer.packingCharts().end(),
+                std::back_inserter(pageCharts),
+                [i, &packer](const PackingChart& chart) { return chart.page() == (int)i && !packer.kept(chart.chart()->id()); }
+            );
+
+            path.str("");
+            path << vizPath << "/atlas-horizons-" << 1001 + i << ".bmp";
+            VizUtil::DrawAtlasHorizons(path.str(), packer.pages()[i], pageCharts);
+
+            path.str("");
+            path << vizPath << "/atlas-horizon-" << 1001 + i << ".bmp";
+            VizUtil::DrawHorizon(path.str(), packer.pages()[i].horizon());
+        }
 
         path.str("");
         path << vizPath << "/atlas-uv.bmp";
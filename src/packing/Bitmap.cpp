@@ -0,0 +1,275 @@
+//
+//  Bitmap.cpp
+//  LSCM
+//
+
+#include "Bitmap.h"
+
+#include <algorithm>
+
+const int WORD_BITS = 64;
+
+namespace
+{
+    // Floor division, as bit offsets may be negative
+    int WordIndex(int x)
+    {
+        return x >= 0 ? x / WORD_BITS : -((-x + WORD_BITS - 1) / WORD_BITS);
+    }
+
+    // The even bits of a word, packed into its low half
+    uint64_t EvenBits(uint64_t x)
+    {
+        x &= 0x5555555555555555ull;
+        x = (x | (x >> 1)) & 0x3333333333333333ull;
+        x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+        x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+        x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+        x = (x | (x >> 16)) & 0x00000000ffffffffull;
+
+        return x;
+    }
+}
+
+Bitmap::Bitmap(int width, int height)
+: _width(width)
+, _height(height)
+, _words((width + WORD_BITS - 1) / WORD_BITS)
+, _bits((size_t)_words * height, 0)
+{
+}
+
+int Bitmap::width() const
+{
+    return _width;
+}
+
+int Bitmap::height() const
+{
+    return _height;
+}
+
+bool Bitmap::get(int x, int y) const
+{
+    if (x < 0 || x >= _width || y < 0 || y >= _height)
+    {
+        return false;
+    }
+
+    return (row(y)[x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+void Bitmap::set(int x, int y)
+{
+    row(y)[x / WORD_BITS] |= uint64_t(1) << (x % WORD_BITS);
+}
+
+void Bitmap::setRow(int y, int x0, int x1)
+{
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, _width);
+
+    auto bits = row(y);
+
+    for (auto x = x0; x < x1;)
+    {
+        const auto offset = x % WORD_BITS;
+        const auto count = std::min(WORD_BITS - offset, x1 - x);
+
+        bits[x / WORD_BITS] |= (count == WORD_BITS ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << offset;
+
+        x += count;
+    }
+}
+
+void Bitmap::clear()
+{
+    std::fill(_bits.begin(), _bits.end(), 0);
+}
+
+uint64_t Bitmap::word(int x, int y) const
+{
+    if (y < 0 || y >= _height || x >= _width || x <= -WORD_BITS)
+    {
+        return 0;
+    }
+
+    const auto bits = row(y);
+    const auto index = WordIndex(x);
+    const auto offset = x - index * WORD_BITS;
+
+    const auto low = index >= 0 ? bits[index] : 0;
+    const auto high = index + 1 < _words ? bits[index + 1] : 0;
+
+    return offset == 0 ? low : (low >> offset) | (high << (WORD_BITS - offset));
+}
+
+bool Bitmap::overlaps(const Bitmap& mask, int x, int y) const
+{
+    const auto y0 = std::max(0, -y);
+    const auto y1 = std::min(mask._height, _height - y);
+
+    for (auto j = y0; j < y1; j++)
+    {
+        const auto bits = mask.row(j);
+
+        for (auto m = 0; m < mask._words; m++)
+        {
+            if (bits[m] != 0 && (bits[m] & word(x + m * WORD_BITS, y + j)) != 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void Bitmap::merge(const Bitmap& mask, int x, int y)
+{
+    if (_words == 0)
+    {
+        return;
+    }
+
+    const auto y0 = std::max(0, -y);
+    const auto y1 = std::min(mask._height, _height - y);
+
+    const auto index = WordIndex(x);
+    const auto offset = x - index * WORD_BITS;
+
+    // Bits past the width are kept clear, as word reads them
+    const auto last = _width % WORD_BITS == 0 ? ~uint64_t(0) : (uint64_t(1) << (_width % WORD_BITS)) - 1;
+
+    for (auto j = y0; j < y1; j++)
+    {
+        const auto from = mask.row(j);
+        const auto to = row(y + j);
+
+        for (auto m = 0; m < mask._words; m++)
+        {
+            const auto i = index + m;
+
+            if (i >= 0 && i < _words)
+            {
+                to[i] |= from[m] << offset;
+            }
+
+            if (offset != 0 && i + 1 >= 0 && i + 1 < _words)
+            {
+                to[i + 1] |= from[m] >> (WORD_BITS - offset);
+            }
+        }
+
+        to[_words - 1] &= last;
+    }
+}
+
+void Bitmap::mergeWord(uint64_t bits, int x, int y)
+{
+    const auto m = x / WORD_BITS;
+
+    if (m == _words - 1 && _width % WORD_BITS != 0)
+    {
+        bits &= (uint64_t(1) << (_width % WORD_BITS)) - 1;
+    }
+
+    row(y)[m] |= bits;
+}
+
+Bitmap Bitmap::dilate(int radius) const
+{
+    Bitmap spread(_width + 2 * radius, _height);
+    Bitmap result(_width + 2 * radius, _height + 2 * radius);
+
+    // Along x, each bit of the result gathers the source bits up to twice
+    // the radius before it, as the source starts radius bits in
+    for (auto y = 0; y < _height; y++)
+    {
+        auto bits = spread.row(y);
+
+        for (auto m = 0; m < spread._words; m++)
+        {
+            uint64_t value = 0;
+
+            for (auto d = 0; d <= 2 * radius; d++)
+            {
+                value |= word(m * WORD_BITS - d, y);
+            }
+
+            bits[m] = value;
+        }
+    }
+
+    for (auto y = 0; y < _height; y++)
+    {
+        const auto from = spread.row(y);
+
+        for (auto d = 0; d <= 2 * radius; d++)
+        {
+            auto to = result.row(y + d);
+
+            for (auto m = 0; m < result._words; m++)
+            {
+                to[m] |= from[m];
+            }
+        }
+    }
+
+    return result;
+}
+
+void Bitmap::coarsen(Bitmap& coarse, bool all, int x0, int y0, int x1, int y1) const
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, coarse._width);
+    y1 = std::min(y1, coarse._height);
+
+    if (x0 >= x1)
+    {
+        return;
+    }
+
+    // Whole words of the coarse bitmap, their bits outside the region are
+    // as up to date as the rest
+    const auto m0 = x0 / WORD_BITS;
+    const auto m1 = (x1 + WORD_BITS - 1) / WORD_BITS;
+
+    for (auto y = y0; y < y1; y++)
+    {
+        const auto top = row(2 * y);
+        const auto bottom = 2 * y + 1 < _height ? row(2 * y + 1) : nullptr;
+
+        const auto to = coarse.row(y);
+
+        for (auto m = m0; m < m1; m++)
+        {
+            uint64_t value = 0;
+
+            for (auto half = 0; half < 2 && 2 * m + half < _words; half++)
+            {
+                const auto a = top[2 * m + half];
+                const auto b = bottom ? bottom[2 * m + half] : 0;
+
+                // Each pair of bits into its lower bit
+                auto pair = all ? (a & b) : (a | b);
+                pair = all ? (pair & (pair >> 1)) : (pair | (pair >> 1));
+
+                value |= EvenBits(pair) << (32 * half);
+            }
+
+            to[m] |= value;
+        }
+    }
+}
+
+uint64_t* Bitmap::row(int y)
+{
+    return _bits.data() + (size_t)y * _words;
+}
+
+const uint64_t* Bitmap::row(int y) const
+{
+    return _bits.data() + (size_t)y * _words;
+}
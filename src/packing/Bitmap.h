@@ -0,0 +1,58 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A grid of bits, each row packed into 64 bit words, the lowest bit of a
+// word first. Masks are placed over each other at any bit offset, and
+// compared or merged a word at a time.
+class Bitmap
+{
+private:
+    int _width;
+    int _height;
+    int _words;
+
+    std::vector<uint64_t> _bits;
+
+public:
+    Bitmap(int width = 0, int height = 0);
+    ~Bitmap() = default;
+
+    int width() const;
+    int height() const;
+
+    bool get(int x, int y) const;
+    void set(int x, int y);
+
+    // Sets the bits of row y in [x0, x1)
+    void setRow(int y, int x0, int x1);
+
+    void clear();
+
+    // The 64 bits of row y from x on, zero outside the bitmap
+    uint64_t word(int x, int y) const;
+
+    // Whether any bit of the mask, its first bit at (x, y), is also set here
+    bool overlaps(const Bitmap& mask, int x, int y) const;
+
+    // Sets the bits of the mask, its first bit at (x, y), clipped to here
+    void merge(const Bitmap& mask, int x, int y);
+
+    // Sets the bits of a word of row y, x a multiple of 64
+    void mergeWord(uint64_t bits, int x, int y);
+
+    // Grown by radius bits on every side, each bit set within radius of a
+    // set bit
+    Bitmap dilate(int radius) const;
+
+    // Sets the bits of the half sized bitmap in [x0, x1) x [y0, y1) whose
+    // 2x2 block here has any, or all, of its bits set
+    void coarsen(Bitmap& coarse, bool all, int x0, int y0, int x1, int y1) const;
+
+private:
+    uint64_t* row(int y);
+    const uint64_t* row(int y) const;
+};
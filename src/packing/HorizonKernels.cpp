@@ -0,0 +1,263 @@
+//
+//  HorizonKernels.cpp
+//  LSCM
+//
+//  The vector kernels are compiled for their instruction sets through target
+//  attributes, so the rest of the build needs no architecture flags and runs
+//  on any x86 CPU. Loads are unaligned, as windows start at every column.
+//
+
+#include "HorizonKernels.h"
+
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HORIZON_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct Kernels
+    {
+        HorizonKernels::Level level;
+
+        float (*maxSum)(const float*, const float*, size_t, float);
+        void (*maxShifted)(float*, const float*, float, size_t);
+        void (*rest)(float*, const float*, float, size_t);
+    };
+
+    float MaxSumScalar(const float* horizon, const float* bottom, size_t n, float init)
+    {
+        auto result = init;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            result = std::max(result, horizon[i] + bottom[i]);
+        }
+
+        return result;
+    }
+
+    void MaxShiftedScalar(float* bounds, const float* horizon, float height, size_t count)
+    {
+        for (size_t x = 0; x < count; x++)
+        {
+            bounds[x] = std::max(bounds[x], horizon[x] + height);
+        }
+    }
+
+    void RestScalar(float* horizon, const float* top, float height, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            horizon[i] = height - top[i];
+        }
+    }
+
+#ifdef HORIZON_KERNELS_X86
+    __attribute__((target("avx2")))
+    float MaxSumAVX2(const float* horizon, const float* bottom, size_t n, float init)
+    {
+        // Two accumulators hide the latency of max
+        auto max0 = _mm256_set1_ps(init);
+        auto max1 = max0;
+
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16)
+        {
+            max0 = _mm256_max_ps(max0, _mm256_add_ps(_mm256_loadu_ps(horizon + i), _mm256_loadu_ps(bottom + i)));
+            max1 = _mm256_max_ps(max1, _mm256_add_ps(_mm256_loadu_ps(horizon + i + 8), _mm256_loadu_ps(bottom + i + 8)));
+        }
+
+        for (; i + 8 <= n; i += 8)
+        {
+            max0 = _mm256_max_ps(max0, _mm256_add_ps(_mm256_loadu_ps(horizon + i), _mm256_loadu_ps(bottom + i)));
+        }
+
+        max0 = _mm256_max_ps(max0, max1);
+
+        auto max = _mm_max_ps(_mm256_castps256_ps128(max0), _mm256_extractf128_ps(max0, 1));
+        max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+        max = _mm_max_ss(max, _mm_shuffle_ps(max, max, 1));
+
+        return MaxSumScalar(horizon + i, bottom + i, n - i, _mm_cvtss_f32(max));
+    }
+
+    __attribute__((target("avx2")))
+    void MaxShiftedAVX2(float* bounds, const float* horizon, float height, size_t count)
+    {
+        const auto h = _mm256_set1_ps(height);
+
+        size_t x = 0;
+
+        for (; x + 8 <= count; x += 8)
+        {
+            _mm256_storeu_ps(bounds + x, _mm256_max_ps(_mm256_loadu_ps(bounds + x), _mm256_add_ps(_mm256_loadu_ps(horizon + x), h)));
+        }
+
+        MaxShiftedScalar(bounds + x, horizon + x, height, count - x);
+    }
+
+    __attribute__((target("avx2")))
+    void RestAVX2(float* horizon, const float* top, float height, size_t n)
+    {
+        const auto h = _mm256_set1_ps(height);
+
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm256_storeu_ps(horizon + i, _mm256_sub_ps(h, _mm256_loadu_ps(top + i)));
+        }
+
+        RestScalar(horizon + i, top + i, height, n - i);
+    }
+
+    // Tails are masked rather than left to scalar loops, masked out lanes
+    // keep their previous values
+
+    __attribute__((target("avx512f")))
+    float MaxSumAVX512(const float* horizon, const float* bottom, size_t n, float init)
+    {
+        auto max0 = _mm512_set1_ps(init);
+        auto max1 = max0;
+
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32)
+        {
+            max0 = _mm512_max_ps(max0, _mm512_add_ps(_mm512_loadu_ps(horizon + i), _mm512_loadu_ps(bottom + i)));
+            max1 = _mm512_max_ps(max1, _mm512_add_ps(_mm512_loadu_ps(horizon + i + 16), _mm512_loadu_ps(bottom + i + 16)));
+        }
+
+        for (; i < n; i += 16)
+        {
+            const auto mask = (__mmask16)(n - i >= 16 ? 0xffff : (1u << (n - i)) - 1);
+            const auto sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, horizon + i), _mm512_maskz_loadu_ps(mask, bottom + i));
+
+            max0 = _mm512_mask_max_ps(max0, mask, max0, sum);
+        }
+
+        return _mm512_reduce_max_ps(_mm512_max_ps(max0, max1));
+    }
+
+    __attribute__((target("avx512f")))
+    void MaxShiftedAVX512(float* bounds, const float* horizon, float height, size_t count)
+    {
+        const auto h = _mm512_set1_ps(height);
+
+        for (size_t x = 0; x < count; x += 16)
+        {
+            const auto mask = (__mmask16)(count - x >= 16 ? 0xffff : (1u << (count - x)) - 1);
+            const auto shifted = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, horizon + x), h);
+
+            _mm512_mask_storeu_ps(bounds + x, mask, _mm512_max_ps(_mm512_maskz_loadu_ps(mask, bounds + x), shifted));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void RestAVX512(float* horizon, const float* top, float height, size_t n)
+    {
+        const auto h = _mm512_set1_ps(height);
+
+        for (size_t i = 0; i < n; i += 16)
+        {
+            const auto mask = (__mmask16)(n - i >= 16 ? 0xffff : (1u << (n - i)) - 1);
+
+            _mm512_mask_storeu_ps(horizon + i, mask, _mm512_sub_ps(h, _mm512_maskz_loadu_ps(mask, top + i)));
+        }
+    }
+#endif
+
+    const Kernels SCALAR = {HorizonKernels::Level::Scalar, MaxSumScalar, MaxShiftedScalar, RestScalar};
+
+#ifdef HORIZON_KERNELS_X86
+    const Kernels AVX2 = {HorizonKernels::Level::AVX2, MaxSumAVX2, MaxShiftedAVX2, RestAVX2};
+    const Kernels AVX512 = {HorizonKernels::Level::AVX512, MaxSumAVX512, MaxShiftedAVX512, RestAVX512};
+#endif
+
+    bool Supported(HorizonKernels::Level level)
+    {
+        switch (level)
+        {
+            case HorizonKernels::Level::Scalar:
+                return true;
+#ifdef HORIZON_KERNELS_X86
+            case HorizonKernels::Level::AVX2:
+                return __builtin_cpu_supports("avx2");
+            case HorizonKernels::Level::AVX512:
+                return __builtin_cpu_supports("avx512f");
+#endif
+            default:
+                return false;
+        }
+    }
+
+    const Kernels* Find(HorizonKernels::Level level)
+    {
+        switch (level)
+        {
+#ifdef HORIZON_KERNELS_X86
+            case HorizonKernels::Level::AVX2:
+                return &AVX2;
+            case HorizonKernels::Level::AVX512:
+                return &AVX512;
+#endif
+            default:
+                return &SCALAR;
+        }
+    }
+
+    const Kernels*& Active()
+    {
+        static const Kernels* kernels = Supported(HorizonKernels::Level::AVX512) ? Find(HorizonKernels::Level::AVX512)
+            : Supported(HorizonKernels::Level::AVX2) ? Find(HorizonKernels::Level::AVX2)
+            : &SCALAR;
+
+        return kernels;
+    }
+}
+
+float HorizonKernels::MaxSum(const float* horizon, const float* bottom, size_t n, float init)
+{
+    return Active()->maxSum(horizon, bottom, n, init);
+}
+
+void HorizonKernels::MaxShifted(float* bounds, const float* horizon, float height, size_t count)
+{
+    Active()->maxShifted(bounds, horizon, height, count);
+}
+
+void HorizonKernels::Rest(float* horizon, const float* top, float height, size_t n)
+{
+    Active()->rest(horizon, top, height, n);
+}
+
+HorizonKernels::Level HorizonKernels::Current()
+{
+    return Active()->level;
+}
+
+const char* HorizonKernels::Name(Level level)
+{
+    switch (level)
+    {
+        case Level::AVX2:
+            return "avx2";
+        case Level::AVX512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+bool HorizonKernels::Select(Level level)
+{
+    const auto supported = Supported(level);
+
+    Active() = supported ? Find(level) : &SCALAR;
+
+    return supported;
+}
@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include <cstddef>
+
+// The reductions packing spends its time in, over float horizons. Each has
+// a scalar version, and AVX2 and AVX-512 versions on x86 builds with GCC or
+// Clang, and the widest the CPU supports is chosen the first time one runs.
+// Every version returns exactly what the scalar one does.
+class HorizonKernels
+{
+public:
+    enum class Level
+    {
+        Scalar,
+        AVX2,
+        AVX512
+    };
+
+    // max(init, horizon[i] + bottom[i]) over n columns
+    static float MaxSum(const float* horizon, const float* bottom, size_t n, float init);
+
+    // bounds[x] = max(bounds[x], horizon[x] + height) over count positions,
+    // one chart column against as many positions at once
+    static void MaxShifted(float* bounds, const float* horizon, float height, size_t count);
+
+    // horizon[i] = height - top[i] over n columns
+    static void Rest(float* horizon, const float* top, float height, size_t n);
+
+    static Level Current();
+    static const char* Name(Level level);
+
+    // Falls back to the scalar kernels for levels the CPU lacks, returns
+    // whether the level was selected. Every kernel of the process goes
+    // through one shared pointer, so this is for setup on a single thread
+    // while no kernel runs, as bench/HorizonBenchmark.cpp does; packing
+    // never calls it.
+    static bool Select(Level level);
+};
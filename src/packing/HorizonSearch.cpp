@@ -0,0 +1,236 @@
+//
+//  HorizonSearch.cpp
+//  LSCM
+//
+//  A chart resting at position x sits at maxY(x) = max(horizon[x + i] + bottom[i]),
+//  and wastes length * maxY(x) - sum(bottom) - sum(horizon[x, x + length)).
+//  The horizon sums are differences of prefix sums, so a lower bound on
+//  maxY(x) gives a lower bound on the waste in constant time:
+//  - the window's highest horizon column plus the chart's shallowest column
+//  - the horizon plus the chart at the chart's deepest columns
+//  Positions are evaluated from the lowest bound up, and the search stops
+//  once no bound can beat the best waste found. The same bound on maxY
+//  orders the positions by the lowest skyline. Contact has no useful bound,
+//  a position's columns resting on the horizon only known once it is
+//  evaluated, so every position is.
+//
+
+#include "HorizonSearch.h"
+
+#include "HorizonKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <deque>
+#include <numeric>
+
+// Columns the chart reaches lowest at, tested at every position
+const size_t SAMPLES = 8;
+
+// Columns between checks against the best waste while evaluating a position
+const size_t BLOCK_SIZE = 256;
+
+// Horizon columns under a chart column with no top are left far below zero,
+// windows over them never hold a chart
+const float UNBOUNDED = 1e30f;
+
+// Wastes closer than this fraction of the largest possible waste are equal,
+// and the leftmost position wins, as when every position was tried in turn
+const double TIE_TOLERANCE = 1e-9;
+
+bool HorizonSearch::find(const PackingChart::Horizon& horizon, const PackingChart::Horizon& bottom, float dimension, Score score, float step, int& position, float& cost)
+{
+    const auto length = bottom.size();
+
+    if (length > horizon.size())
+    {
+        return false;
+    }
+
+    if (length == 0)
+    {
+        position = 0;
+        cost = 0;
+        return true;
+    }
+
+    const auto count = horizon.size() - length + 1;
+
+    buildSums(horizon);
+    buildWindowMax(horizon, length);
+
+    auto total = 0.0;
+    auto minBottom = FLT_MAX;
+
+    for (const auto b : bottom)
+    {
+        total += b;
+        minBottom = std::min(minBottom, b);
+    }
+
+    const auto numSamples = std::min(SAMPLES, length);
+
+    _samples.resize(length);
+    std::iota(_samples.begin(), _samples.end(), 0);
+    std::partial_sort(_samples.begin(), _samples.begin() + numSamples, _samples.end(), [&bottom](int a, int b) { return bottom[b] < bottom[a]; });
+    _samples.resize(numSamples);
+
+    // Bounds of every position, one chart column at a time
+    _lower.assign(count, FLT_MIN);
+
+    HorizonKernels::MaxShifted(_lower.data(), _windowMax.data(), minBottom, count);
+
+    for (const auto i : _samples)
+    {
+        HorizonKernels::MaxShifted(_lower.data(), horizon.data() + i, bottom[i], count);
+    }
+
+    // The cost of a position once the chart rests at maxY, and its least
+    // cost from a lower bound on maxY
+    const auto costAt = [&](int x, float maxY)
+    {
+        switch (score)
+        {
+            case Score::LowestSkyline:
+                return (double)maxY;
+
+            case Score::Contact:
+            {
+                auto contact = 0;
+
+                for (size_t i = 0; i < length; i++)
+                {
+                    contact += horizon[x + i] + bottom[i] >= maxY - step ? 1 : 0;
+                }
+
+                return maxY / (double)dimension - contact;
+            }
+
+            default:
+                return length * (double)maxY - total - (_sums[x + length] - _sums[x]);
+        }
+    };
+
+    const auto boundAt = [&](int x)
+    {
+        return score == Score::Contact ? _lower[x] / (double)dimension - length : costAt(x, _lower[x]);
+    };
+
+    _bounds.resize(count);
+    _positions.clear();
+
+    for (auto x = 0; x < count; x++)
+    {
+        if (_unbounded[x + length] != _unbounded[x] || _lower[x] >= dimension)
+        {
+            continue;
+        }
+
+        _bounds[x] = boundAt(x);
+        _positions.push_back(x);
+    }
+
+    std::sort(
+        _positions.begin(),
+        _positions.end(),
+        [this](int a, int b)
+        {
+            return _bounds[a] < _bounds[b] || (_bounds[a] == _bounds[b] && a < b);
+        }
+    );
+
+    // Costs of contact count whole columns
+    const auto tolerance = TIE_TOLERANCE * (score == Score::Contact ? 1.0 : score == Score::LowestSkyline ? dimension : length * dimension);
+
+    auto found = false;
+    auto minCost = DBL_MAX;
+
+    for (const auto x : _positions)
+    {
+        if (_bounds[x] > minCost + tolerance)
+        {
+            break;
+        }
+
+        auto maxY = FLT_MIN;
+        auto rejected = false;
+
+        for (size_t start = 0; start < length && !rejected; start += BLOCK_SIZE)
+        {
+            const auto end = std::min(start + BLOCK_SIZE, length);
+
+            maxY = HorizonKernels::MaxSum(horizon.data() + x + start, bottom.data() + start, end - start, maxY);
+
+            rejected = maxY >= dimension || (score != Score::Contact && costAt(x, maxY) > minCost + tolerance);
+        }
+
+        if (rejected)
+        {
+            continue;
+        }
+
+        const auto current = costAt(x, maxY);
+
+        if (!found || current < minCost - tolerance || (current <= minCost + tolerance && x < position))
+        {
+            minCost = current;
+            position = x;
+            found = true;
+        }
+    }
+
+    if (found)
+    {
+        cost = (float)minCost;
+    }
+
+    return found;
+}
+
+void HorizonSearch::buildSums(const PackingChart::Horizon& horizon)
+{
+    _sums.resize(horizon.size() + 1);
+    _unbounded.resize(horizon.size() + 1);
+
+    _sums[0] = 0;
+    _unbounded[0] = 0;
+
+    for (auto j = 0; j < horizon.size(); j++)
+    {
+        const auto unbounded = std::abs(horizon[j]) > UNBOUNDED;
+
+        _sums[j + 1] = _sums[j] + (unbounded ? 0.0 : horizon[j]);
+        _unbounded[j + 1] = _unbounded[j] + (unbounded ? 1 : 0);
+    }
+}
+
+void HorizonSearch::buildWindowMax(const PackingChart::Horizon& horizon, size_t length)
+{
+    const auto count = horizon.size() - length + 1;
+
+    _windowMax.resize(count);
+
+    // Indices of decreasing horizon values, the front is the window's max
+    std::deque<size_t> candidates;
+
+    for (size_t j = 0; j < horizon.size(); j++)
+    {
+        while (!candidates.empty() && horizon[candidates.back()] <= horizon[j])
+        {
+            candidates.pop_back();
+        }
+
+        candidates.push_back(j);
+
+        if (candidates.front() + length <= j)
+        {
+            candidates.pop_front();
+        }
+
+        if (j + 1 >= length)
+        {
+            _windowMax[j + 1 - length] = horizon[candidates.front()];
+        }
+    }
+}
@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <vector>
+
+#include "PackingChart.h"
+
+// Finds where along a horizon a chart scores best once it rests on it, by
+// default where it wastes the least space, the space between the horizon
+// and the chart's bottom. Sums over each window come from prefix sums, and
+// cheap lower bounds on each position's resting height order the positions
+// and prune the ones that cannot beat the best found, so few are evaluated
+// in full.
+class HorizonSearch
+{
+public:
+    enum class Score
+    {
+        // Least space left between the chart and the horizon
+        WastedSpace,
+
+        // Lowest top of the chart, and so of the horizon after it
+        LowestSkyline,
+
+        // Most columns of the chart resting on the horizon, then lowest
+        Contact
+    };
+
+private:
+    std::vector<double> _sums;
+    std::vector<int> _unbounded;
+
+    PackingChart::Horizon _windowMax;
+    PackingChart::Horizon _lower;
+    std::vector<double> _bounds;
+    std::vector<int> _positions;
+    std::vector<int> _samples;
+
+public:
+    HorizonSearch() = default;
+    ~HorizonSearch() = default;
+
+    // Position of the chart's first column, false if it fits nowhere below
+    // dimension. Lower costs score better, columns within step of resting
+    // touch the horizon
+    bool find(const PackingChart::Horizon& horizon, const PackingChart::Horizon& bottom, float dimension, Score score, float step, int& position, float& cost);
+
+private:
+    void buildSums(const PackingChart::Horizon& horizon);
+    void buildWindowMax(const PackingChart::Horizon& horizon, size_t length);
+};
@@ -0,0 +1,621 @@
+//
+//  OccupancyAtlas.cpp
+//  LSCM
+//
+//  A block of 2^k x 2^k positions at level k is given up when either:
+//  - a block of the atlas is partly covered where the mask covers it
+//    wholly, from every position of the block. From any of them, block a
+//    of the atlas falls within blocks a - 1 and a of the mask, along each
+//    axis, so it is covered wholly when those four are
+//  - the mask covers a texel of a block, which falls in one of the four
+//    atlas blocks from it, and all four are covered
+//  Blocks are searched from the top level down, lowest and leftmost first,
+//  and a block is skipped once it cannot hold a lower position than found.
+//
+
+#include "OccupancyAtlas.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Scales of the charts against the atlas tried, from the tightest atlas to
+// the loosest, as in PackingAtlas
+const float MAX_SCALE = 5.0f;
+const float MIN_SCALE = 1.0f;
+const float SCALE_STEP = 0.1f;
+
+// Blocks across the top level, at least
+const int TOP_SIZE = 16;
+
+namespace
+{
+    struct Placement
+    {
+        bool fits = false;
+        int x = 0;
+        int y = 0;
+    };
+
+    // Sets every texel the triangle touches, the texels of each row between
+    // the leftmost and rightmost points of the triangle within the row
+    void Rasterize(Bitmap& bitmap, const Mesh::TexCoord2D (&points)[3])
+    {
+        const auto minY = std::min({points[0][1], points[1][1], points[2][1]});
+        const auto maxY = std::max({points[0][1], points[1][1], points[2][1]});
+
+        const auto y0 = std::max(0, (int)std::floor(minY));
+        const auto y1 = std::min(bitmap.height() - 1, (int)std::floor(maxY));
+
+        for (auto y = y0; y <= y1; y++)
+        {
+            const float bounds[2] = {(float)y, (float)(y + 1)};
+
+            auto left = FLT_MAX;
+            auto right = -FLT_MAX;
+
+            for (auto i = 0; i < 3; i++)
+            {
+                const auto& a = points[i];
+                const auto& b = points[(i + 1) % 3];
+
+                if (a[1] >= bounds[0] && a[1] <= bounds[1])
+                {
+                    left = std::min(left, a[0]);
+                    right = std::max(right, a[0]);
+                }
+
+                for (const auto bound : bounds)
+                {
+                    if ((a[1] - bound) * (b[1] - bound) < 0)
+                    {
+                        const auto x = a[0] + (bound - a[1]) / (b[1] - a[1]) * (b[0] - a[0]);
+
+                        left = std::min(left, x);
+                        right = std::max(right, x);
+                    }
+                }
+            }
+
+            if (left <= right)
+            {
+                bitmap.setRow(y, (int)std::floor(left), (int)std::floor(right) + 1);
+            }
+        }
+    }
+
+    // Sets the texels whose centres lie inside the outline, by the number of
+    // its edges crossed along each row
+    void Fill(Bitmap& bitmap, const std::vector<PackingChart::UVEdge>& edges)
+    {
+        std::vector<std::pair<int, float>> crossings;
+
+        for (const auto& edge : edges)
+        {
+            const auto& a = edge.first;
+            const auto& b = edge.second;
+
+            const auto y0 = std::max(0, (int)std::ceil(std::min(a[1], b[1]) - 0.5f));
+            const auto y1 = std::min(bitmap.height() - 1, (int)std::ceil(std::max(a[1], b[1]) - 0.5f) - 1);
+
+            for (auto y = y0; y <= y1; y++)
+            {
+                const auto center = y + 0.5f;
+
+                crossings.emplace_back(y, a[0] + (center - a[1]) / (b[1] - a[1]) * (b[0] - a[0]));
+            }
+        }
+
+        std::sort(crossings.begin(), crossings.end());
+
+        // Outlines are closed, so each row's crossings pair up
+        for (size_t i = 0; i < crossings.size();)
+        {
+            const auto y = crossings[i].first;
+
+            auto end = i;
+
+            while (end < crossings.size() && crossings[end].first == y)
+            {
+                end++;
+            }
+
+            for (auto j = i; j + 1 < end; j += 2)
+            {
+                bitmap.setRow(y, (int)std::ceil(crossings[j].second - 0.5f), (int)std::floor(crossings[j + 1].second - 0.5f) + 1);
+            }
+
+            i = end;
+        }
+    }
+
+    Bitmap Coarsen(const Bitmap& bitmap, bool all)
+    {
+        Bitmap coarse((bitmap.width() + 1) / 2, (bitmap.height() + 1) / 2);
+
+        bitmap.coarsen(coarse, all, 0, 0, coarse.width(), coarse.height());
+
+        return coarse;
+    }
+
+    // Each bit set when it and the bits left of it, above it and above
+    // left of it are
+    Bitmap Core(const Bitmap& full)
+    {
+        Bitmap core(full.width(), full.height());
+
+        for (auto y = 0; y < full.height(); y++)
+        {
+            for (auto x = 0; x < full.width(); x += 64)
+            {
+                core.mergeWord(full.word(x, y) & full.word(x - 1, y) & full.word(x, y - 1) & full.word(x - 1, y - 1), x, y);
+            }
+        }
+
+        return core;
+    }
+}
+
+OccupancyAtlas::OccupancyAtlas(Mesh* mesh, float resolution, int padding)
+: _mesh(mesh)
+, _resolution(resolution)
+, _dimension(0)
+, _step(0)
+, _padding(padding)
+, _maxDimensions(0, 0)
+, _turns{0}
+, _cutoff(nullptr)
+{
+
+}
+
+float OccupancyAtlas::resolution() const
+{
+    return _resolution;
+}
+
+float OccupancyAtlas::dimension() const
+{
+    return _dimension;
+}
+
+int OccupancyAtlas::padding() const
+{
+    return _padding;
+}
+
+const Bitmap& OccupancyAtlas::occupancy() const
+{
+    return _occupied.front();
+}
+
+void OccupancyAtlas::setTurns(const std::vector<int>& turns)
+{
+    _turns = turns;
+}
+
+void OccupancyAtlas::setCutoff(const PackingCutoff* cutoff)
+{
+    _cutoff = cutoff;
+}
+
+bool OccupancyAtlas::pack(std::vector<PackingChart>& charts)
+{
+    _maxDimensions = Mesh::TexCoord2D(0, 0);
+
+    for (auto &chart : charts)
+    {
+        _maxDimensions[0] += chart.width();
+        _maxDimensions[1] += chart.height();
+    }
+
+    std::vector<float> scales;
+
+    for (auto scale = MAX_SCALE; scale > MIN_SCALE; scale -= SCALE_STEP)
+    {
+        scales.push_back(scale);
+    }
+
+    const auto numScales = (std::ptrdiff_t)scales.size();
+
+    // The tightest scale that fits wins, as in PackingAtlas::pack
+    std::atomic<std::ptrdiff_t> winner(numScales);
+    std::atomic<int> attempts(0);
+
+    auto best = *this;
+    std::vector<PackingChart> bestCharts;
+
+    #pragma omp parallel
+    {
+        auto atlas = *this;
+        auto local = charts;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (std::ptrdiff_t i = 0; i < numScales; i++)
+        {
+            if (winner < i)
+            {
+                continue;
+            }
+
+            attempts++;
+
+            if (atlas.attempt(local, scales[i], i, winner))
+            {
+                #pragma omp critical
+                if (i < winner)
+                {
+                    winner = i;
+                    best = atlas;
+                    bestCharts = local;
+                }
+            }
+        }
+    }
+
+    if (winner < numScales)
+    {
+        *this = best;
+        charts = bestCharts;
+
+        // A portfolio reports the packs it cuts off itself
+        if (!_cutoff)
+        {
+            std::cout << "Scale: " << scales[winner] << " (" << attempts << " attempts)" << std::endl;
+        }
+
+        return true;
+    }
+
+    if (_cutoff)
+    {
+        return false;
+    }
+
+    // Leaves the charts as the loosest scale left them
+    attempt(charts, scales.back(), numScales, winner);
+
+    std::cout << "*Failed to pack Charts at any scale..." << std::endl;
+
+    return false;
+}
+
+bool OccupancyAtlas::attempt(std::vector<PackingChart>& charts, float scale, std::ptrdiff_t index, const std::atomic<std::ptrdiff_t>& winner)
+{
+    estimateDimension(scale);
+
+    auto extent = Mesh::TexCoord2D(0, 0);
+
+    for (auto &chart : charts)
+    {
+        // A tighter scale already fits
+        if (winner < index)
+        {
+            return false;
+        }
+
+        if (!place(chart))
+        {
+            return false;
+        }
+
+        extent.maximize(chart.extent());
+
+        if (_cutoff && _cutoff->reached(extent))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool OccupancyAtlas::place(PackingChart& chart)
+{
+    const auto numTurns = (std::ptrdiff_t)_turns.size();
+
+    std::vector<PackingChart> candidates(numTurns, chart);
+    std::vector<Footprint> footprints(numTurns);
+    std::vector<Placement> placements(numTurns);
+
+    #pragma omp taskloop default(shared) if(numTurns > 1)
+    for (std::ptrdiff_t k = 0; k < numTurns; k++)
+    {
+        auto& placement = placements[k];
+
+        if (candidates[k].turn() != _turns[k])
+        {
+            candidates[k].setTurn(_turns[k]);
+        }
+
+        footprints[k] = rasterize(candidates[k]);
+
+        placement.fits = find(footprints[k], placement.x, placement.y);
+    }
+
+    // The first turn listed wins ties
+    auto best = -1;
+
+    for (auto k = 0; k < numTurns; k++)
+    {
+        const auto& placement = placements[k];
+
+        if (placement.fits && (best < 0 || placement.y < placements[best].y || (placement.y == placements[best].y && placement.x < placements[best].x)))
+        {
+            best = k;
+        }
+    }
+
+    if (best < 0)
+    {
+        return false;
+    }
+
+    const auto& footprint = footprints[best];
+    const auto& placement = placements[best];
+
+    merge(footprint, placement.x, placement.y);
+
+    // The chart's first texel starts inside the padding of its mask
+    chart = std::move(candidates[best]);
+    chart.setPosition(Mesh::TexCoord2D(
+        (placement.x + _padding) * _step - footprint.min[0],
+        (placement.y + _padding) * _step + footprint.max[1]
+    ));
+
+    return true;
+}
+
+OccupancyAtlas::Footprint OccupancyAtlas::rasterize(const PackingChart& chart) const
+{
+    const auto& texCoords = chart.chart()->texCoords();
+
+    Footprint footprint;
+
+    footprint.min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
+    footprint.max = Mesh::TexCoord2D(-FLT_MAX, -FLT_MAX);
+
+    for (const auto& vertex : chart.chart()->vertices())
+    {
+        const auto uv = chart.turnUV(_mesh->property(texCoords, vertex));
+
+        footprint.min.minimize(uv);
+        footprint.max.maximize(uv);
+    }
+
+    const auto width = (int)((footprint.max[0] - footprint.min[0]) / _step) + 1;
+    const auto height = (int)((footprint.max[1] - footprint.min[1]) / _step) + 1;
+
+    footprint.area = Bitmap(width, height);
+
+    // Rows go down from the top of the chart, as charts hang from their
+    // position in the atlas
+    const auto texel = [&](const Mesh::VertexHandle& vertex)
+    {
+        const auto uv = chart.turnUV(_mesh->property(texCoords, vertex));
+
+        return Mesh::TexCoord2D((uv[0] - footprint.min[0]) / _step, (footprint.max[1] - uv[1]) / _step);
+    };
+
+    const auto& perimeterEdges = chart.chart()->perimeterEdges();
+
+    if (perimeterEdges.empty())
+    {
+        // Closed charts have no outline, so each face is rasterized instead
+        for (const auto& face : chart.chart()->faces())
+        {
+            Mesh::TexCoord2D points[3];
+
+            auto i = 0;
+
+            for (auto fv_it = _mesh->cfv_begin(face), end = _mesh->cfv_end(face); fv_it != end && i < 3; ++fv_it, i++)
+            {
+                points[i] = texel(*fv_it);
+            }
+
+            Rasterize(footprint.area, points);
+        }
+    }
+    else
+    {
+        // A texel the chart touches is either crossed by the outline or
+        // wholly inside it
+        std::vector<PackingChart::UVEdge> edges;
+
+        for (const auto& edge : perimeterEdges)
+        {
+            const auto halfedge = _mesh->halfedge_handle(edge, 0);
+
+            edges.emplace_back(texel(_mesh->from_vertex_handle(halfedge)), texel(_mesh->to_vertex_handle(halfedge)));
+
+            const Mesh::TexCoord2D points[3] = {edges.back().first, edges.back().second, edges.back().second};
+
+            Rasterize(footprint.area, points);
+        }
+
+        Fill(footprint.area, edges);
+    }
+
+    footprint.mask = footprint.area.dilate(_padding);
+
+    const auto numLevels = _occupied.size();
+
+    footprint.cores.resize(numLevels);
+    footprint.anys.resize(numLevels);
+
+    auto full = footprint.mask;
+
+    for (size_t k = 1; k < numLevels; k++)
+    {
+        footprint.anys[k] = Coarsen(k == 1 ? footprint.mask : footprint.anys[k - 1], false);
+
+        full = Coarsen(full, true);
+        footprint.cores[k] = Core(full);
+    }
+
+    return footprint;
+}
+
+bool OccupancyAtlas::find(const Footprint& footprint, int& x, int& y) const
+{
+    const auto maxX = (int)_resolution - footprint.mask.width();
+    const auto maxY = (int)_resolution - footprint.mask.height();
+
+    if (maxX < 0 || maxY < 0)
+    {
+        return false;
+    }
+
+    const auto top = (int)_occupied.size() - 1;
+
+    auto found = false;
+
+    // Each row of top level blocks holds lower positions than the next
+    for (auto by = 0; (by << top) <= maxY && !found; by++)
+    {
+        for (auto bx = 0; (bx << top) <= maxX; bx++)
+        {
+            search(footprint, top, bx, by, maxX, maxY, x, y, found);
+        }
+    }
+
+    return found;
+}
+
+void OccupancyAtlas::search(const Footprint& footprint, int level, int bx, int by, int maxX, int maxY, int& x, int& y, bool& found) const
+{
+    const auto x0 = bx << level;
+    const auto y0 = by << level;
+
+    if (x0 > maxX || y0 > maxY || (found && (y0 > y || (y0 == y && x0 >= x))))
+    {
+        return;
+    }
+
+    if (level == 0)
+    {
+        if (!_occupied[0].overlaps(footprint.mask, x0, y0))
+        {
+            x = x0;
+            y = y0;
+            found = true;
+        }
+
+        return;
+    }
+
+    if (_occupied[level].overlaps(footprint.cores[level], bx, by) || _blocked[level].overlaps(footprint.anys[level], bx, by))
+    {
+        return;
+    }
+
+    for (auto cy = 0; cy < 2; cy++)
+    {
+        for (auto cx = 0; cx < 2; cx++)
+        {
+            search(footprint, level - 1, 2 * bx + cx, 2 * by + cy, maxX, maxY, x, y, found);
+        }
+    }
+}
+
+void OccupancyAtlas::merge(const Footprint& footprint, int x, int y)
+{
+    x += _padding;
+    y += _padding;
+
+    _occupied[0].merge(footprint.area, x, y);
+
+    update(x, y, x + footprint.area.width(), y + footprint.area.height());
+}
+
+void OccupancyAtlas::update(int x0, int y0, int x1, int y1)
+{
+    for (size_t k = 1; k < _occupied.size(); k++)
+    {
+        x0 /= 2;
+        y0 /= 2;
+        x1 = (x1 + 1) / 2;
+        y1 = (y1 + 1) / 2;
+
+        _occupied[k - 1].coarsen(_occupied[k], false, x0, y0, x1, y1);
+        (k == 1 ? _occupied[0] : _full[k - 1]).coarsen(_full[k], true, x0, y0, x1, y1);
+
+        // Each block's neighbourhood reaches the blocks right of and below it
+        const auto& full = _full[k];
+        auto& blocked = _blocked[k];
+
+        for (auto y = std::max(y0 - 1, 0); y < y1; y++)
+        {
+            for (auto x = std::max(x0 - 1, 0) / 64 * 64; x < x1; x += 64)
+            {
+                const auto value = full.word(x, y) & full.word(x + 1, y) & full.word(x, y + 1) & full.word(x + 1, y + 1);
+
+                blocked.mergeWord(value, x, y);
+            }
+        }
+    }
+}
+
+void OccupancyAtlas::estimateDimension(float scale)
+{
+    open(std::max(_maxDimensions[0], _maxDimensions[1]) / scale);
+}
+
+void OccupancyAtlas::open(float dimension)
+{
+    _dimension = dimension;
+    _step = _dimension / _resolution;
+
+    const auto size = (int)_resolution;
+
+    auto numLevels = 1;
+
+    while ((size >> numLevels) >= TOP_SIZE)
+    {
+        numLevels++;
+    }
+
+    // Whole top level blocks, the texels past the resolution never free
+    const auto block = 1 << (numLevels - 1);
+    const auto padded = (size + block - 1) / block * block;
+
+    _occupied.assign(1, Bitmap(padded, padded));
+    _full.assign(1, Bitmap());
+    _blocked.assign(1, Bitmap());
+
+    for (auto k = 1; k < numLevels; k++)
+    {
+        _occupied.emplace_back(padded >> k, padded >> k);
+        _full.emplace_back(padded >> k, padded >> k);
+        _blocked.emplace_back(padded >> k, padded >> k);
+    }
+
+    for (auto y = 0; y < padded; y++)
+    {
+        _occupied[0].setRow(y, y < size ? size : 0, padded);
+    }
+
+    update(0, 0, padded, padded);
+}
+
+void OccupancyAtlas::restore(float dimension, const Bitmap& occupancy, const Mesh::TexCoord2D& extent)
+{
+    open(dimension);
+
+    auto& occupied = _occupied.front();
+
+    occupied.merge(occupancy, 0, 0);
+
+    // Charts past the extent would scale the UVs of those already packed,
+    // so the texels past it are never free
+    const auto size = (int)_resolution;
+    const auto width = extent[0] < _dimension ? std::min((int)(extent[0] / _step), size) : size;
+    const auto height = extent[1] < _dimension ? std::min((int)(extent[1] / _step), size) : size;
+
+    for (auto y = 0; y < occupied.height(); y++)
+    {
+        occupied.setRow(y, y < height ? width : 0, occupied.width());
+    }
+
+    update(0, 0, occupied.width(), occupied.height());
+}
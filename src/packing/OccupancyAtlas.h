@@ -0,0 +1,106 @@
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "Bitmap.h"
+#include "PackingChart.h"
+#include "PackingCutoff.h"
+
+// Packs charts by their rasterized footprints rather than their horizons,
+// so charts can go into holes and concavities beside others. The atlas is
+// a bitmap of the texels covered, a chart fits where its footprint, grown
+// by the padding, meets none of them, and goes to the lowest such place,
+// then leftmost. Coarser levels of both prune whole blocks of positions.
+class OccupancyAtlas
+{
+private:
+    struct Footprint
+    {
+        // Bounds of the chart's UVs, which its first texel starts at
+        Mesh::TexCoord2D min;
+        Mesh::TexCoord2D max;
+
+        // Texels the chart covers, and those no other chart may cover
+        Bitmap area;
+        Bitmap mask;
+
+        // At each level, the blocks of the mask covered from every position
+        // of a block, and the blocks covered from any
+        std::vector<Bitmap> cores;
+        std::vector<Bitmap> anys;
+    };
+
+    Mesh* _mesh;
+
+    float _resolution;
+    float _dimension;
+    float _step;
+
+    int _padding;
+
+    Mesh::TexCoord2D _maxDimensions;
+
+    // At each level, the blocks with any texel covered, with every texel
+    // covered, and whose 2x2 neighbourhood is all covered
+    std::vector<Bitmap> _occupied;
+    std::vector<Bitmap> _full;
+    std::vector<Bitmap> _blocked;
+
+    // Turns of each chart tried, see PackingChart::turn
+    std::vector<int> _turns;
+
+    const PackingCutoff* _cutoff;
+
+public:
+    OccupancyAtlas(Mesh* mesh, float resolution = 2048.0f, int padding = 1);
+    ~OccupancyAtlas() = default;
+
+    float resolution() const;
+    float dimension() const;
+    int padding() const;
+
+    // Texels covered by the charts packed
+    const Bitmap& occupancy() const;
+
+    // Places each chart in whichever of these turns goes lowest, only as
+    // parameterized by default
+    void setTurns(const std::vector<int>& turns);
+
+    // Packing gives up, without falling back to the loosest scale, once
+    // the cutoff is reached. None by default
+    void setCutoff(const PackingCutoff* cutoff);
+
+    bool pack(std::vector<PackingChart>& charts);
+
+    // Empties the atlas at a fixed dimension, for placing charts one at a
+    // time rather than scaling them all to fit
+    void open(float dimension);
+
+    // Opens the atlas on texels saved at this dimension, new charts going
+    // within the extent its charts were scaled from
+    void restore(float dimension, const Bitmap& occupancy, const Mesh::TexCoord2D& extent);
+
+    // Places the chart in the lowest, then leftmost, position it fits,
+    // false if it fits nowhere
+    bool place(PackingChart& chart);
+
+private:
+    void estimateDimension(float scale);
+
+    // Packs the charts at one scale, stopping at the first that does not
+    // fit, or once the attempt of a tighter scale has fit
+    bool attempt(std::vector<PackingChart>& charts, float scale, std::ptrdiff_t index, const std::atomic<std::ptrdiff_t>& winner);
+
+    Footprint rasterize(const PackingChart& chart) const;
+
+    // Lowest, then leftmost, position of the footprint's mask
+    bool find(const Footprint& footprint, int& x, int& y) const;
+    void search(const Footprint& footprint, int level, int bx, int by, int maxX, int maxY, int& x, int& y, bool& found) const;
+
+    void merge(const Footprint& footprint, int x, int y);
+
+    // Brings the coarser levels up to date over a region of texels
+    void update(int x0, int y0, int x1, int y1);
+};
@@ -5,13 +5,54 @@
 
 #include "Packer.h"
 
+#include "HorizonKernels.h"
+
+#include "../util/Calipers.h"
 #include "../util/MeshUtil.h"
 
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+
 using namespace Charts;
 
+namespace
+{
+    const char* OrderName(Packer::Order order)
+    {
+        switch (order)
+        {
+            case Packer::Order::Area: return "area";
+            case Packer::Order::Perimeter: return "perimeter";
+            case Packer::Order::MaxSide: return "side";
+            default: return "height";
+        }
+    }
+
+    const char* ScoreName(Packer::Score score)
+    {
+        switch (score)
+        {
+            case Packer::Score::LowestSkyline: return "skyline";
+            case Packer::Score::Contact: return "contact";
+            default: return "waste";
+        }
+    }
+}
+
 Packer::Packer(Mesh* mesh, const std::vector<Chart>* charts, float resolution, int padding)
 : _mesh(mesh)
 , _atlas(mesh, resolution, padding)
+, _occupancyAtlas(mesh, resolution, padding)
+, _engine(Engine::Horizon)
+, _density(0)
+, _frames(nullptr)
+, _orientation(Orientation::Diameter)
+, _order(Order::Height)
+, _score(Score::WastedSpace)
+, _portfolio(false)
+, _portfolioBudget(0)
+, _layout(nullptr)
 {
     for (const auto& chart : *charts)
     {
@@ -34,10 +75,100 @@ const PackingAtlas& Packer::atlas() const
     return _atlas;
 }
 
+const OccupancyAtlas& Packer::occupancyAtlas() const
+{
+    return _occupancyAtlas;
+}
+
+const std::vector<PackingAtlas>& Packer::pages() const
+{
+    return _pages;
+}
+
+void Packer::setFaceFrames(const FaceFrames* frames)
+{
+    _frames = frames;
+}
+
+void Packer::setEngine(Engine engine)
+{
+    _engine = engine;
+}
+
+void Packer::setOrientation(Orientation orientation)
+{
+    _orientation = orientation;
+}
+
+void Packer::setTurns(bool quarterTurns, bool mirror)
+{
+    std::vector<int> turns;
+
+    for (auto turn = 0; turn < 8; turn++)
+    {
+        if ((quarterTurns || turn % 4 == 0) && (mirror || turn < 4))
+        {
+            turns.push_back(turn);
+        }
+    }
+
+    _atlas.setTurns(turns);
+    _occupancyAtlas.setTurns(turns);
+}
+
+void Packer::setPages(float density)
+{
+    _density = density;
+}
+
+void Packer::setOrder(Order order)
+{
+    _order = order;
+}
+
+void Packer::setScore(Score score)
+{
+    _score = score;
+    _atlas.setScore(score);
+}
+
+void Packer::setPortfolio(bool portfolio, double seconds)
+{
+    _portfolio = portfolio;
+    _portfolioBudget = seconds;
+}
+
+void Packer::setLayout(const PackingLayout* layout)
+{
+    _layout = layout;
+}
+
+bool Packer::kept(size_t id) const
+{
+    return _kept.count(id) > 0;
+}
+
 bool Packer::pack()
 {
     std::cout << "Packing Charts..." << std::endl;
 
+    if (_engine == Engine::Horizon || _density > 0)
+    {
+        std::cout << "Horizon kernels: " << HorizonKernels::Name(HorizonKernels::Current()) << std::endl;
+    }
+
+    if (_layout)
+    {
+        const auto occupancy = _layout->occupancy.width() > 0;
+
+        if (_layout->resolution != _atlas.resolution() || _layout->padding != _atlas.padding() || _layout->density != _density
+            || occupancy != (_engine == Engine::Occupancy) || (!occupancy && _density == 0 && _layout->horizons.size() != 1))
+        {
+            std::cout << "*Layout was packed at another resolution, padding, density or engine..." << std::endl;
+            return false;
+        }
+    }
+
     for (auto& chart : _packingCharts)
     {
         transformUV(chart);
@@ -45,42 +176,450 @@ bool Packer::pack()
         chart.build(_mesh);
     }
 
-    std::sort(
-        _packingCharts.begin(),
-        _packingCharts.end(),
-        [](const PackingChart& a, const PackingChart& b)
+    Sort(_packingCharts, _order);
+
+    _kept.clear();
+
+    if (_layout)
+    {
+        keep();
+    }
+
+    auto success = false;
+
+    if (_density > 0)
+    {
+        success = packPages();
+    }
+    else
+    {
+        if (_layout)
         {
-            return b.height() < a.height();
-            //return (b.height() * b.width()) < (a.height() * a.width());
+            success = packLayout();
         }
-    );
+        else if (_portfolio)
+        {
+            success = packPortfolio();
+        }
+        else
+        {
+            success = _engine == Engine::Occupancy ? _occupancyAtlas.pack(_packingCharts) : _atlas.pack(_packingCharts);
+        }
+
+        if (success)
+        {
+            const auto size = extent();
+
+            auto area = 0.0f;
+
+            for (const auto& chart : _packingCharts)
+            {
+                area += uvArea(chart);
+            }
+
+            std::cout << "Utilization: " << area / (size[0] * size[1]) << std::endl;
+        }
+    }
+
+    auto turned = 0;
+    auto mirrored = 0;
+
+    for (const auto& chart : _packingCharts)
+    {
+        turned += chart.turn() % 4 != 0 ? 1 : 0;
+        mirrored += chart.turn() >= 4 ? 1 : 0;
+    }
 
-    return _atlas.pack(_packingCharts);
+    if (turned > 0 || mirrored > 0)
+    {
+        std::cout << "Turned: " << turned << " Mirrored: " << mirrored << std::endl;
+    }
+
+    return success;
 }
 
-void Packer::apply()
+bool Packer::packPages()
 {
-    std::cout << "Applying UVs..." << std::endl;
+    _pages.clear();
 
-    auto maxUV = Mesh::TexCoord2D(FLT_MIN, FLT_MIN);
+    const auto dimension = _atlas.resolution() / _density;
+
+    // Pages of the layout take new charts wherever they are left room
+    if (_layout)
+    {
+        for (const auto& horizon : _layout->horizons)
+        {
+            auto page = _atlas;
+            page.restore(dimension, horizon, Mesh::TexCoord2D(dimension, dimension));
+
+            _pages.push_back(std::move(page));
+        }
+    }
+
+    auto success = true;
+
+    // Charts go one at a time, largest first, each searching every open page
+    // at once and resting on whichever wastes the least space
+    #pragma omp parallel
+    #pragma omp single
+    for (auto& chart : _packingCharts)
+    {
+        if (kept(chart.chart()->id()))
+        {
+            continue;
+        }
+
+        const auto numPages = (std::ptrdiff_t)_pages.size();
+
+        std::vector<PackingChart> candidates(numPages, chart);
+        std::vector<PackingAtlas::Placement> placements(numPages);
+
+        #pragma omp taskloop default(shared)
+        for (std::ptrdiff_t i = 0; i < numPages; i++)
+        {
+            auto& placement = placements[i];
+
+            placement.fits = _pages[i].find(candidates[i], placement.position, placement.cost);
+        }
+
+        // The earliest page wins ties
+        auto best = -1;
+
+        for (auto i = 0; i < numPages; i++)
+        {
+            if (placements[i].fits && (best < 0 || placements[i].cost < placements[best].cost))
+            {
+                best = i;
+            }
+        }
+
+        auto position = 0;
+
+        if (best >= 0)
+        {
+            chart = std::move(candidates[best]);
+            position = placements[best].position;
+        }
+        else
+        {
+            auto page = _atlas;
+            page.open(dimension);
+
+            auto cost = 0.0f;
+
+            if (!page.find(chart, position, cost))
+            {
+                std::cout << "*Chart " << chart.chart()->id() << " is larger than a page..." << std::endl;
+
+                success = false;
+                break;
+            }
+
+            best = (int)numPages;
+            _pages.push_back(std::move(page));
+        }
+
+        chart.setPage(best);
+        _pages[best].place(chart, position);
+    }
+
+    if (!success)
+    {
+        return false;
+    }
 
-    auto start = _packingCharts.begin(), end = _packingCharts.end();
+    std::vector<int> numCharts(_pages.size(), 0);
+    std::vector<float> areas(_pages.size(), 0);
 
     for (const auto& chart : _packingCharts)
     {
-        const auto position = chart.position(false);
-        const auto min = chart.min(false);
-        const auto max = chart.max(false);
+        numCharts[chart.page()]++;
+        areas[chart.page()] += uvArea(chart);
+    }
+
+    std::cout << "Pages: " << _pages.size() << std::endl;
+
+    for (size_t i = 0; i < _pages.size(); i++)
+    {
+        std::cout << "\tPage " << 1001 + i << ": " << numCharts[i] << " charts, fill " << areas[i] / (dimension * dimension) << std::endl;
+    }
+
+    return true;
+}
+
+bool Packer::packLayout()
+{
+    if (_engine == Engine::Occupancy)
+    {
+        _occupancyAtlas.restore(_layout->dimension, _layout->occupancy, _layout->extent);
+    }
+    else
+    {
+        _atlas.restore(_layout->dimension, _layout->horizons.front(), _layout->extent);
+    }
+
+    auto success = true;
+
+    // Turns are still tried in parallel
+    #pragma omp parallel
+    #pragma omp single
+    for (auto& chart : _packingCharts)
+    {
+        if (kept(chart.chart()->id()))
+        {
+            continue;
+        }
+
+        if (!(_engine == Engine::Occupancy ? _occupancyAtlas.place(chart) : _atlas.place(chart)))
+        {
+            std::cout << "*Chart " << chart.chart()->id() << " does not fit around the layout..." << std::endl;
+
+            success = false;
+            break;
+        }
+    }
+
+    return success;
+}
+
+bool Packer::packPortfolio()
+{
+    struct Entry
+    {
+        Order order;
+        Score score;
+
+        std::vector<PackingChart> charts;
+        PackingAtlas atlas;
+        OccupancyAtlas occupancyAtlas;
+
+        bool packed;
+        double seconds;
+    };
+
+    // The order and score set come first, the occupancy engine has no
+    // scores to try
+    std::vector<Order> orders{_order};
+    std::vector<Score> scores{_score};
+
+    for (const auto order : {Order::Height, Order::Area, Order::Perimeter, Order::MaxSide})
+    {
+        if (order != _order)
+        {
+            orders.push_back(order);
+        }
+    }
+
+    for (const auto score : {Score::WastedSpace, Score::LowestSkyline, Score::Contact})
+    {
+        if (score != _score && _engine == Engine::Horizon)
+        {
+            scores.push_back(score);
+        }
+    }
+
+    std::vector<Entry> entries;
+
+    for (const auto order : orders)
+    {
+        for (const auto score : scores)
+        {
+            entries.push_back({order, score, {}, _atlas, _occupancyAtlas, false, 0});
+        }
+    }
+
+    auto area = 0.0f;
+
+    for (const auto& chart : _packingCharts)
+    {
+        area += uvArea(chart);
+    }
+
+    PackingCutoff cutoff;
+    cutoff.setBudget(_portfolioBudget);
+
+    const auto numEntries = (std::ptrdiff_t)entries.size();
+
+    // One entry to a thread, each packing its scales in turn
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::ptrdiff_t i = 0; i < numEntries; i++)
+    {
+        auto& entry = entries[i];
+
+        const auto start = PackingCutoff::Clock::now();
+
+        entry.charts = _packingCharts;
+        Sort(entry.charts, entry.order);
+
+        // The first entry always finishes, so there is a layout to keep
+        const auto entryCutoff = i == 0 ? nullptr : &cutoff;
+
+        if (_engine == Engine::Occupancy)
+        {
+            entry.occupancyAtlas.setCutoff(entryCutoff);
+            entry.packed = entry.occupancyAtlas.pack(entry.charts);
+            entry.occupancyAtlas.setCutoff(nullptr);
+        }
+        else
+        {
+            entry.atlas.setScore(entry.score);
+            entry.atlas.setCutoff(entryCutoff);
+            entry.packed = entry.atlas.pack(entry.charts);
+            entry.atlas.setCutoff(nullptr);
+        }
+
+        if (entry.packed)
+        {
+            cutoff.offer(Extent(entry.charts));
+        }
+
+        entry.seconds = std::chrono::duration<double>(PackingCutoff::Clock::now() - start).count();
+    }
+
+    // Earlier entries win ties
+    auto best = -1;
+    auto bestUtilization = 0.0f;
+
+    std::cout << "Portfolio:" << std::endl;
+
+    for (auto i = 0; i < numEntries; i++)
+    {
+        const auto& entry = entries[i];
+
+        std::cout << "\t" << OrderName(entry.order);
+
+        if (_engine == Engine::Horizon)
+        {
+            std::cout << " " << ScoreName(entry.score);
+        }
+
+        if (entry.packed)
+        {
+            const auto size = Extent(entry.charts);
+            const auto utilization = area / (size[0] * size[1]);
+
+            std::cout << ": " << utilization;
+
+            if (best < 0 || utilization > bestUtilization)
+            {
+                best = i;
+                bestUtilization = utilization;
+            }
+        }
+        else
+        {
+            std::cout << ": given up";
+        }
+
+        std::cout << " (" << entry.seconds << "s)" << std::endl;
+    }
+
+    // Left as the order and score set left them
+    auto& kept = entries[std::max(best, 0)];
+
+    _packingCharts = std::move(kept.charts);
+    _atlas = kept.atlas;
+    _occupancyAtlas = kept.occupancyAtlas;
 
-        maxUV[0] = std::max(maxUV[0], position[0] + max[0]);
-        maxUV[1] = std::max(maxUV[1], position[1] + min[1]);
+    if (best >= 0)
+    {
+        std::cout << "Order: " << OrderName(kept.order);
+
+        if (_engine == Engine::Horizon)
+        {
+            std::cout << " Score: " << ScoreName(kept.score);
+        }
+
+        std::cout << std::endl;
+    }
+
+    return best >= 0;
+}
+
+void Packer::keep()
+{
+    std::unordered_multimap<uint64_t, size_t> placements;
+
+    for (size_t i = 0; i < _layout->placements.size(); i++)
+    {
+        placements.emplace(_layout->placements[i].key.hash, i);
     }
 
+    const auto numCharts = (std::ptrdiff_t)_packingCharts.size();
+
+    std::vector<PackingLayout::Placement> currents(numCharts);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (std::ptrdiff_t i = 0; i < numCharts; i++)
+    {
+        currents[i] = placement(_packingCharts[i]);
+    }
+
+    // Identical copies take the placement nearest them, so copies keep
+    // their own UVs as long as they are not moved past one another
+    for (std::ptrdiff_t i = 0; i < numCharts; i++)
+    {
+        auto& chart = _packingCharts[i];
+
+        const auto& current = currents[i];
+        const auto range = placements.equal_range(current.key.hash);
+
+        auto best = placements.end();
+        auto minDistance = FLT_MAX;
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const auto& other = _layout->placements[it->second];
+            const auto distance = (other.center - current.center).sqrnorm();
+
+            if (distance < minDistance && other.key.matches(current.key))
+            {
+                best = it;
+                minDistance = distance;
+            }
+        }
+
+        if (best != placements.end())
+        {
+            chart.setPage(_layout->placements[best->second].page);
+
+            _kept[chart.chart()->id()] = best->second;
+            placements.erase(best);
+        }
+    }
+
+    std::cout << "Kept: " << _kept.size() << "/" << _packingCharts.size() << " charts" << std::endl;
+}
+
+void Packer::apply()
+{
+    std::cout << "Applying UVs..." << std::endl;
+
+    const auto maxUV = _pages.empty() ? extent() : Mesh::TexCoord2D(_pages.front().dimension(), _pages.front().dimension());
+
     for (const auto& chart : _packingCharts)
     {
+        const auto kept = _kept.find(chart.chart()->id());
+
+        if (kept != _kept.end())
+        {
+            const auto& uvs = _layout->placements[kept->second].uvs;
+            const auto& vertices = chart.chart()->vertices();
+
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                _mesh->set_texcoord2D(vertices[i], uvs[i]);
+            }
+
+            continue;
+        }
+
         const auto position = chart.position(false);
         const auto min = chart.min(false);
 
+        // UDIM tile of the chart's page
+        const auto tile = Mesh::TexCoord2D(chart.page() % 10, chart.page() / 10);
+
         const auto& texCoords = chart.chart()->texCoords();
 
         auto minTex = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
@@ -88,15 +627,109 @@ void Packer::apply()
 
         for (const auto& vertex : chart.chart()->vertices())
         {
-            auto uv = _mesh->property(texCoords, vertex);
-            uv[0] = (position[0] + uv[0]) / maxUV[0];
-            uv[1] = (position[1] - uv[1]) / maxUV[1];
+            auto uv = chart.turnUV(_mesh->property(texCoords, vertex));
+            uv[0] = tile[0] + (position[0] + uv[0]) / maxUV[0];
+            uv[1] = tile[1] + (position[1] - uv[1]) / maxUV[1];
 
             _mesh->set_texcoord2D(vertex, uv);
         }
     }
 }
 
+PackingLayout Packer::layout() const
+{
+    PackingLayout layout;
+
+    layout.resolution = _atlas.resolution();
+    layout.padding = _atlas.padding();
+    layout.density = _density;
+
+    if (_density > 0)
+    {
+        layout.dimension = _atlas.resolution() / _density;
+        layout.extent = Mesh::TexCoord2D(layout.dimension, layout.dimension);
+
+        for (const auto& page : _pages)
+        {
+            layout.horizons.push_back(page.horizon());
+        }
+    }
+    else if (_engine == Engine::Occupancy)
+    {
+        layout.dimension = _occupancyAtlas.dimension();
+        layout.extent = extent();
+        layout.occupancy = _occupancyAtlas.occupancy();
+    }
+    else
+    {
+        layout.dimension = _atlas.dimension();
+        layout.extent = extent();
+        layout.horizons.push_back(_atlas.horizon());
+    }
+
+    for (const auto& chart : _packingCharts)
+    {
+        auto current = placement(chart);
+
+        current.page = chart.page();
+
+        for (const auto& vertex : chart.chart()->vertices())
+        {
+            current.uvs.push_back(_mesh->texcoord2D(vertex));
+        }
+
+        layout.placements.push_back(std::move(current));
+    }
+
+    return layout;
+}
+
+PackingLayout::Placement Packer::placement(const PackingChart& chart) const
+{
+    PackingLayout::Placement placement;
+
+    const auto& vertices = chart.chart()->vertices();
+
+    placement.key = IntrinsicKey::Build(_mesh, chart.chart()->faces(), vertices);
+    placement.center = Mesh::Point(0, 0, 0);
+    placement.page = 0;
+
+    for (const auto& vertex : vertices)
+    {
+        placement.center += _mesh->point(vertex);
+    }
+
+    if (!vertices.empty())
+    {
+        placement.center /= (float)vertices.size();
+    }
+
+    return placement;
+}
+
+void Packer::Sort(std::vector<PackingChart>& charts, Order order)
+{
+    const auto size = [order](const PackingChart& chart)
+    {
+        switch (order)
+        {
+            case Order::Area: return chart.width() * chart.height();
+            case Order::Perimeter: return chart.width() + chart.height();
+            case Order::MaxSide: return std::max(chart.width(), chart.height());
+            default: return chart.height();
+        }
+    };
+
+    std::sort(
+        charts.begin(),
+        charts.end(),
+        [&size](const PackingChart& a, const PackingChart& b)
+        {
+            return size(b) < size(a);
+        }
+    );
+}
+
 void Packer::transformUV(const PackingChart& chart)
 {
     auto& texCoords = chart.chart()->texCoords();
@@ -147,6 +780,53 @@ void Packer::transformUV(const PackingChart& chart)
     }
 }
 
+Mesh::TexCoord2D Packer::extent() const
+{
+    // Charts packed around a layout are scaled as its charts were
+    if (_layout)
+    {
+        return _layout->extent;
+    }
+
+    return Extent(_packingCharts);
+}
+
+Mesh::TexCoord2D Packer::Extent(const std::vector<PackingChart>& charts)
+{
+    auto maxUV = Mesh::TexCoord2D(FLT_MIN, FLT_MIN);
+
+    for (const auto& chart : charts)
+    {
+        maxUV.maximize(chart.extent());
+    }
+
+    return maxUV;
+}
+
+float Packer::uvArea(const PackingChart& chart) const
+{
+    auto& texCoords = chart.chart()->texCoords();
+
+    auto area = 0.0f;
+
+    for (const auto& face : chart.chart()->faces())
+    {
+        auto fv_it = _mesh->cfv_begin(face);
+
+        const auto& uvP = MeshUtil::AsPoint(_mesh->property(texCoords, *fv_it));
+        ++fv_it;
+
+        const auto& uvQ = MeshUtil::AsPoint(_mesh->property(texCoords, *fv_it));
+        ++fv_it;
+
+        const auto& uvR = MeshUtil::AsPoint(_mesh->property(texCoords, *fv_it));
+
+        area += ((uvQ - uvP) % (uvR - uvP)).norm() * 0.5f;
+    }
+
+    return area;
+}
+
 void Packer::scaling(const PackingChart& chart, float& scale)
 {
     auto& texCoords = chart.chart()->texCoords();
@@ -169,46 +849,48 @@ void Packer::scaling(const PackingChart& chart, float& scale)
         const auto& pR = _mesh->point(*fv_it);
         const auto& uvR = MeshUtil::AsPoint(_mesh->property(texCoords, *fv_it));
 
-        pointArea += ((pQ - pP) % (pR - pP)).norm() * 0.5f;
+        pointArea += _frames ? _frames->area(face) : ((pQ - pP) % (pR - pP)).norm() * 0.5f;
         uvArea += ((uvQ - uvP) % (uvR - uvP)).norm() * 0.5f;
     }
 
-    scale = std::max(1.0f, pointArea / uvArea);
+    // Pages keep the density exactly, so a chart's lengths are scaled to
+    // its surface's, by the root of their areas
+    scale = _density > 0 ? std::sqrt(pointArea / uvArea) : std::max(1.0f, pointArea / uvArea);
 }
 
 void Packer::rotation(const PackingChart& chart, float& theta, Mesh::TexCoord2D& center)
 {
     auto& texCoords = chart.chart()->texCoords();
 
-    const auto& perimeter = chart.chart()->perimeter();
+    Calipers::Points perimeter;
 
-    auto diameter = std::array<int, 2>{0, 0};
-    auto maxLengthSqr = 0.0;
-
-    for (auto i = 0; i < perimeter.size(); i++)
+    for (const auto& vertex : chart.chart()->perimeter())
     {
-        const auto& pi = _mesh->property(texCoords, perimeter[i]);
+        perimeter.push_back(_mesh->property(texCoords, vertex));
+    }
 
-        for (auto j = i + 1; j < perimeter.size(); j++)
-        {
-            const auto& pj = _mesh->property(texCoords, perimeter[j]);
+    // Closed charts have no perimeter to turn by
+    if (perimeter.empty())
+    {
+        theta = 0;
+        center = Mesh::TexCoord2D(0, 0);
+        return;
+    }
 
-            auto lengthSqr = (pi - pj).sqrnorm();
-            if (lengthSqr > maxLengthSqr)
-            {
-                maxLengthSqr = lengthSqr;
-                diameter[0] = i;
-                diameter[1] = j;
-            }
-        }
+    if (_orientation != Orientation::Diameter)
+    {
+        theta = _orientation == Orientation::MinArea ? Calipers::MinAreaRotation(perimeter) : Calipers::MinHeightRotation(perimeter);
+        center = perimeter.front();
+        return;
     }
 
-    const auto& p = _mesh->property(texCoords, perimeter[diameter[0]]);
-    const auto& q = _mesh->property(texCoords, perimeter[diameter[1]]);
+    const auto diameter = Calipers::Diameter(perimeter);
+
+    const auto& p = perimeter[diameter.first];
+    const auto& q = perimeter[diameter.second];
     const auto v = q - p;
     const auto d = v.normalized();
 
     theta = (d[0] < 0 ? -1.0f : 1.0f) * std::acos(d | Mesh::TexCoord2D(0, 1));
     center = p;
 }
-
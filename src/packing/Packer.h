@@ -2,19 +2,87 @@
 #pragma once
 
 #include "../util/MeshDef.h"
+#include "../util/FaceFrames.h"
 #include "../charts/Chart.h"
 #include "PackingAtlas.h"
+#include "OccupancyAtlas.h"
+#include "PackingLayout.h"
 
 #include <cstdio>
+#include <map>
 
 class Packer
 {
+public:
+    enum class Orientation
+    {
+        // Chart diameter along y
+        Diameter,
+
+        // Bounding box of least area, its longer side along y
+        MinArea,
+
+        // Bounding box of least height
+        MinHeight
+    };
+
+    enum class Order
+    {
+        // Tallest chart first
+        Height,
+
+        // Largest bounding box first
+        Area,
+
+        // Longest bounding box perimeter first
+        Perimeter,
+
+        // Longest bounding box side first
+        MaxSide
+    };
+
+    typedef PackingAtlas::Score Score;
+
+    enum class Engine
+    {
+        // Each chart rests on the horizon of the charts below it
+        Horizon,
+
+        // Each chart's rasterized footprint goes wherever it meets no other,
+        // into holes and concavities too
+        Occupancy
+    };
+
 private:
     Mesh* _mesh;
 
     std::vector<PackingChart> _packingCharts;
 
     PackingAtlas _atlas;
+    OccupancyAtlas _occupancyAtlas;
+
+    Engine _engine;
+
+    // Texels per unit of the charts on each page, single atlas when 0
+    float _density;
+    std::vector<PackingAtlas> _pages;
+
+    const FaceFrames* _frames;
+
+    Orientation _orientation;
+
+    Order _order;
+    Score _score;
+
+    // Every order with every score at once, for at most this many seconds
+    // once the order and score set are packed, 0 for no limit
+    bool _portfolio;
+    double _portfolioBudget;
+
+    // Charts packed before, and the placement of the layout each chart kept
+    // takes its UVs from, by chart id
+    const PackingLayout* _layout;
+    std::map<size_t, size_t> _kept;
 
 public:
     Packer(Mesh* mesh, const std::vector<Charts::Chart>* charts, float resolution = 2048.0f, int padding = 4);
@@ -24,12 +92,81 @@ public:
     const PackingChart& packingChart(size_t id) const;
 
     const PackingAtlas& atlas() const;
+    const OccupancyAtlas& occupancyAtlas() const;
+
+    // Pages the charts were packed onto, empty for a single atlas
+    const std::vector<PackingAtlas>& pages() const;
+
+    // Surface areas of the faces, computed from the mesh when not set
+    void setFaceFrames(const FaceFrames* frames);
+
+    // Horizon by default. Pages are only packed by the horizon engine
+    void setEngine(Engine engine);
+
+    // How each chart is turned before packing, Diameter by default
+    void setOrientation(Orientation orientation);
+
+    // Also tries each chart in the other three quarter turns, and mirrored,
+    // keeping the one that wastes the least space
+    void setTurns(bool quarterTurns, bool mirror);
+
+    // Packs the charts at this many texels per unit onto as many pages of
+    // the resolution as they need, instead of scaling them all onto one.
+    // Each page is a UDIM tile, page i offset by (i % 10, i / 10) in UV
+    void setPages(float density);
+
+    // Order the charts are packed in, Height by default
+    void setOrder(Order order);
+
+    // How the horizon engine scores the places of each chart, WastedSpace
+    // by default
+    void setScore(Score score);
+
+    // Packs the charts in every order, and with the horizon engine with
+    // every score, at once, keeping the layout using the most of its
+    // extent. The order and score set always finish, the others give up
+    // past the budget, 0 for none, or once they cannot use their extent
+    // better than a layout finished already. Single atlases only
+    void setPortfolio(bool portfolio, double seconds = 0);
+
+    // Keeps the charts of a layout packed before where it put them, packing
+    // only the other charts, into the space it left. The layout must have
+    // been packed at the same resolution, padding, density and engine
+    void setLayout(const PackingLayout* layout);
+
+    // Whether the chart was kept where the layout put it
+    bool kept(size_t id) const;
 
     bool pack();
 
     void apply();
 
+    // The charts as applied and the state of the atlas they were packed
+    // into, for packing new charts around them later
+    PackingLayout layout() const;
+
 private:
+    bool packPages();
+
+    // Packs the charts not kept into the layout's single atlas
+    bool packLayout();
+
+    bool packPortfolio();
+
+    static void Sort(std::vector<PackingChart>& charts, Order order);
+
+    // Matches charts to the layout's placements by their geometry
+    void keep();
+
+    // Key and centre of the chart, as a layout identifies it
+    PackingLayout::Placement placement(const PackingChart& chart) const;
+
+    float uvArea(const PackingChart& chart) const;
+
+    // Size of the single atlas the charts were packed into
+    Mesh::TexCoord2D extent() const;
+    static Mesh::TexCoord2D Extent(const std::vector<PackingChart>& charts);
+
     void scaling(const PackingChart& chart, float& scale);
     void rotation(const PackingChart& chart, float& theta, Mesh::TexCoord2D& center);
 
@@ -4,13 +4,26 @@
 
 #include "PackingAtlas.h"
 
+#include "HorizonKernels.h"
+
+// Scales of the charts against the atlas tried, from the tightest atlas to
+// the loosest
+const float MAX_SCALE = 5.0f;
+const float MIN_SCALE = 1.0f;
+const float SCALE_STEP = 0.1f;
+
 PackingAtlas::PackingAtlas(Mesh* mesh, float resolution, int padding)
 : _mesh(mesh)
 , _resolution(resolution)
 , _dimension(0)
 , _step(0)
+, _height(0)
 , _padding(padding)
 , _maxDimensions(0, 0)
+, _turns{0}
+, _searches(1)
+, _score(Score::WastedSpace)
+, _cutoff(nullptr)
 {
 
 }
@@ -25,112 +38,250 @@ float PackingAtlas::dimension() const
     return _dimension;
 }
 
+int PackingAtlas::padding() const
+{
+    return _padding;
+}
+
 const PackingChart::Horizon& PackingAtlas::horizon() const
 {
     return _horizon;
 }
 
+void PackingAtlas::setTurns(const std::vector<int>& turns)
+{
+    _turns = turns;
+    _searches.resize(turns.size());
+}
+
+void PackingAtlas::setScore(Score score)
+{
+    _score = score;
+}
+
+void PackingAtlas::setCutoff(const PackingCutoff* cutoff)
+{
+    _cutoff = cutoff;
+}
+
 bool PackingAtlas::pack(std::vector<PackingChart>& charts)
 {
+    _maxDimensions = Mesh::TexCoord2D(0, 0);
+
     for (auto &chart : charts)
     {
         _maxDimensions[0] += chart.width();
         _maxDimensions[1] += chart.height();
     }
 
-    auto success = false;
-    for (auto scale = 5.0f; scale > 1 && !success; scale -= 0.1f)
+    std::vector<float> scales;
+
+    for (auto scale = MAX_SCALE; scale > MIN_SCALE; scale -= SCALE_STEP)
     {
-        std::cout << "Scale: " << scale << std::endl;
+        scales.push_back(scale);
+    }
 
-        estimateDimension(scale);
+    const auto numScales = (std::ptrdiff_t)scales.size();
 
-        for (auto &chart : charts)
-        {
-            chart.buildHorizons(_step, _padding);
+    // The tightest scale that fits wins, as in a sweep down from the top.
+    // Threads take scales in order, so every scale before the winner is
+    // packed in full, and the ones after it are skipped or given up early.
+    std::atomic<std::ptrdiff_t> winner(numScales);
+    std::atomic<int> attempts(0);
 
-            success = false;
+    auto best = *this;
+    std::vector<PackingChart> bestCharts;
 
-            auto minPosition = 0;
-            auto minWasted = FLT_MAX;
-            auto wastedSpace = 0.0f;
+    #pragma omp parallel
+    {
+        auto atlas = *this;
+        auto local = charts;
 
-            if (chart.length() <= _horizon.size())
+        #pragma omp for schedule(dynamic, 1)
+        for (std::ptrdiff_t i = 0; i < numScales; i++)
+        {
+            if (winner < i)
             {
-                for (auto i = 0; i <= _horizon.size() - chart.length(); i++)
-                {
-                    if (estimateWastedSpace(i, chart, wastedSpace))
-                    {
-                        if (wastedSpace < minWasted)
-                        {
-                            minWasted = wastedSpace;
-                            minPosition = i;
-                            success = true;
-                        }
-                    }
-                }
+                continue;
             }
 
-            if (success)
-            {
-                chart.setPosition(mergeChart(minPosition, chart));
-            }
-            else
+            attempts++;
+
+            if (atlas.attempt(local, scales[i], i, winner))
             {
-                std::cout << "*Failed to pack Chart " << chart.chart()->id() << "..." << std::endl;
-                break;
+                #pragma omp critical
+                if (i < winner)
+                {
+                    winner = i;
+                    best = atlas;
+                    bestCharts = local;
+                }
             }
         }
     }
 
-    return success;
+    if (winner < numScales)
+    {
+        *this = best;
+        charts = bestCharts;
+
+        // A portfolio reports the packs it cuts off itself
+        if (!_cutoff)
+        {
+            std::cout << "Scale: " << scales[winner] << " (" << attempts << " attempts)" << std::endl;
+        }
+
+        return true;
+    }
+
+    if (_cutoff)
+    {
+        return false;
+    }
+
+    // Leaves the charts as the loosest scale left them
+    attempt(charts, scales.back(), numScales, winner);
+
+    std::cout << "*Failed to pack Charts at any scale..." << std::endl;
+
+    return false;
 }
 
-bool PackingAtlas::estimateWastedSpace(int x, const PackingChart& chart, float& wastedSpace)
+bool PackingAtlas::attempt(std::vector<PackingChart>& charts, float scale, std::ptrdiff_t index, const std::atomic<std::ptrdiff_t>& winner)
 {
-    const auto& bottom = chart.bottomHorizon();
+    estimateDimension(scale);
 
-    auto maxY = FLT_MIN;
+    auto extent = Mesh::TexCoord2D(0, 0);
 
-    for (auto i = 0, j = x; i < bottom.size(); i++, j++)
+    for (auto &chart : charts)
     {
-        maxY = std::max(maxY, _horizon[j] + bottom[i]);
+        // A tighter scale already fits
+        if (winner < index)
+        {
+            return false;
+        }
+
+        if (!place(chart))
+        {
+            return false;
+        }
+
+        extent.maximize(chart.extent());
+
+        if (_cutoff && _cutoff->reached(extent))
+        {
+            return false;
+        }
     }
 
-    if (maxY >= _dimension)
+    return true;
+}
+
+void PackingAtlas::open(float dimension)
+{
+    _dimension = dimension;
+    _step = _dimension / _resolution;
+    _height = _dimension;
+
+    _horizon.resize(_resolution);
+    std::fill(_horizon.begin(), _horizon.end(), 0);
+}
+
+void PackingAtlas::restore(float dimension, const PackingChart::Horizon& horizon, const Mesh::TexCoord2D& extent)
+{
+    open(dimension);
+
+    // Charts past the extent would scale the UVs of those already packed,
+    // so the columns past it are dropped and charts rest below it
+    const auto columns = extent[0] < _dimension ? (size_t)(extent[0] / _step) : horizon.size();
+
+    _horizon.assign(horizon.begin(), horizon.begin() + std::min(columns, horizon.size()));
+    _height = std::min(extent[1], _dimension);
+}
+
+bool PackingAtlas::find(PackingChart& chart, int& position, float& cost)
+{
+    if (_turns.size() == 1)
     {
-        wastedSpace = FLT_MAX;
-        return false;
+        if (chart.turn() != _turns[0])
+        {
+            chart.setTurn(_turns[0]);
+        }
+
+        chart.buildHorizons(_step, _padding);
+
+        return _searches[0].find(_horizon, chart.bottomHorizon(), _height, _score, _step, position, cost);
     }
 
-    wastedSpace = 0;
+    const auto numTurns = (std::ptrdiff_t)_turns.size();
+
+    std::vector<PackingChart> candidates(numTurns, chart);
+    std::vector<Placement> placements(numTurns);
 
-    for (auto i = 0, j = x; i < bottom.size(); i++, j++)
+    // Tasks, so threads whose scale was given up help the ones still packing
+    #pragma omp taskloop default(shared)
+    for (std::ptrdiff_t k = 0; k < numTurns; k++)
     {
-        const auto diff = maxY - bottom[i] - _horizon[j];
+        auto& placement = placements[k];
 
-        wastedSpace += diff;
+        candidates[k].setTurn(_turns[k]);
+        candidates[k].buildHorizons(_step, _padding);
+
+        placement.fits = _searches[k].find(_horizon, candidates[k].bottomHorizon(), _height, _score, _step, placement.position, placement.cost);
     }
 
+    // The first turn listed wins ties
+    auto best = -1;
+
+    for (auto k = 0; k < numTurns; k++)
+    {
+        if (placements[k].fits && (best < 0 || placements[k].cost < placements[best].cost))
+        {
+            best = k;
+        }
+    }
+
+    if (best < 0)
+    {
+        return false;
+    }
+
+    chart = std::move(candidates[best]);
+
+    position = placements[best].position;
+    cost = placements[best].cost;
+
     return true;
 }
 
-Mesh::TexCoord2D PackingAtlas::mergeChart(int x, const PackingChart& chart)
+void PackingAtlas::place(PackingChart& chart, int position)
 {
-    auto maxY = FLT_MIN;
+    chart.setPosition(mergeChart(position, chart));
+}
 
-    const auto& top = chart.topHorizon();
-    const auto& bottom = chart.bottomHorizon();
+bool PackingAtlas::place(PackingChart& chart)
+{
+    auto position = 0;
+    auto cost = 0.0f;
 
-    for (auto i = 0, j = x; i < bottom.size(); i++, j++)
+    if (!find(chart, position, cost))
     {
-        maxY = std::max(maxY, _horizon[j] + bottom[i]);
+        return false;
     }
 
-    for (auto i = 0, j = x; i < bottom.size(); i++, j++)
-    {
-        _horizon[j] = maxY - top[i];
-    }
+    place(chart, position);
+
+    return true;
+}
+
+Mesh::TexCoord2D PackingAtlas::mergeChart(int x, const PackingChart& chart)
+{
+    const auto& top = chart.topHorizon();
+    const auto& bottom = chart.bottomHorizon();
+
+    const auto maxY = HorizonKernels::MaxSum(_horizon.data() + x, bottom.data(), bottom.size(), FLT_MIN);
+
+    HorizonKernels::Rest(_horizon.data() + x, top.data(), maxY, bottom.size());
 
     return {(float)x * _step, maxY};
 }
@@ -140,6 +291,7 @@ void PackingAtlas::estimateDimension(float scale)
     _dimension = std::max(_maxDimensions[0], _maxDimensions[1]) / scale;
 
     _step = _dimension / _resolution;
+    _height = _dimension;
 
     _horizon.resize(_dimension / _step);
     std::fill(_horizon.begin(), _horizon.end(), 0);
@@ -1,12 +1,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <cfloat>
+#include <cstddef>
 #include <map>
 
+#include "HorizonSearch.h"
 #include "PackingChart.h"
+#include "PackingCutoff.h"
 
 class PackingAtlas
 {
+public:
+    typedef HorizonSearch::Score Score;
+
+    struct Placement
+    {
+        bool fits = false;
+        int position = 0;
+        float cost = FLT_MAX;
+    };
+
 private:
     Mesh* _mesh;
 
@@ -14,26 +29,70 @@ private:
     float _dimension;
     float _step;
 
+    // Highest a chart may rest, the dimension unless restored from a layout
+    float _height;
+
     int _padding;
 
     Mesh::TexCoord2D _maxDimensions;
 
     PackingChart::Horizon _horizon;
 
+    // Turns of each chart tried, see PackingChart::turn
+    std::vector<int> _turns;
+    std::vector<HorizonSearch> _searches;
+
+    Score _score;
+
+    const PackingCutoff* _cutoff;
+
 public:
     PackingAtlas(Mesh* mesh, float resolution = 2048.0f, int padding = 1);
     ~PackingAtlas() = default;
 
     float resolution() const;
     float dimension() const;
+    int padding() const;
 
     const PackingChart::Horizon& horizon() const;
 
+    // Places each chart in whichever of these turns scores best, only as
+    // parameterized by default
+    void setTurns(const std::vector<int>& turns);
+
+    // How the places of each chart are scored, WastedSpace by default
+    void setScore(Score score);
+
+    // Packing gives up, without falling back to the loosest scale, once
+    // the cutoff is reached. None by default
+    void setCutoff(const PackingCutoff* cutoff);
+
     bool pack(std::vector<PackingChart>& charts);
 
+    // Empties the atlas at a fixed dimension, for placing charts one at a
+    // time rather than scaling them all to fit
+    void open(float dimension);
+
+    // Where the chart scores best, leaving it in the turn that does, false
+    // if it fits nowhere
+    bool find(PackingChart& chart, int& position, float& cost);
+
+    // Rests the chart on the horizon at a position found for it
+    void place(PackingChart& chart, int position);
+
+    // Finds where the chart scores best and rests it there
+    bool place(PackingChart& chart);
+
+    // Opens the atlas on a horizon saved at this dimension, new charts
+    // resting on it within the extent its charts were scaled from
+    void restore(float dimension, const PackingChart::Horizon& horizon, const Mesh::TexCoord2D& extent);
+
 private:
     void estimateDimension(float scale);
 
-    bool estimateWastedSpace(int x, const PackingChart& chart, float& wastedSpace);
+    // Packs the charts at one scale, stopping at the first that does not
+    // fit, or once the attempt of a tighter scale has fit
+    bool attempt(std::vector<PackingChart>& charts, float scale, std::ptrdiff_t index, const std::atomic<std::ptrdiff_t>& winner);
+
     Mesh::TexCoord2D mergeChart(int x, const PackingChart& chart);
 };
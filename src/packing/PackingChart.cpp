@@ -4,9 +4,13 @@
 
 #include "PackingChart.h"
 
+#include <algorithm>
+
 PackingChart::PackingChart(const Chart* chart)
 : _chart(chart)
-, _scale(-1)
+, _page(0)
+, _turn(0)
+, _offset(0, 0)
 {
 }
 
@@ -15,15 +19,17 @@ const Chart* PackingChart::chart() const
     return _chart;
 }
 
-Mesh::TexCoord2D PackingChart::position(bool scaled) const
+Mesh::TexCoord2D PackingChart::position(bool padded) const
 {
-    if (scaled)
+    if (padded)
         return _position;
     else
     {
+        // Charts hang down from their position in the atlas, so the padding
+        // above the chart moves it down
         return _position + Mesh::TexCoord2D(
                 (width(true) - width(false)) / 2,
-                (height(true) - height(false)) / 2
+                -(height(true) - height(false)) / 2
         );
     }
 }
@@ -33,53 +39,119 @@ void PackingChart::setPosition(const Mesh::TexCoord2D& p)
     _position = p;
 }
 
-float PackingChart::height(bool scaled) const
+int PackingChart::page() const
+{
+    return _page;
+}
+
+void PackingChart::setPage(int page)
+{
+    _page = page;
+}
+
+float PackingChart::height(bool padded) const
+{
+    return std::abs(chartData(padded).max[1] - chartData(padded).min[1]);
+}
+
+float PackingChart::width(bool padded) const
+{
+    return std::abs(chartData(padded).max[0] - chartData(padded).min[0]);
+}
+
+size_t PackingChart::length(bool padded) const
+{
+    return chartData(padded).top.size();
+}
+
+const Mesh::TexCoord2D& PackingChart::min(bool padded) const
 {
-    return std::abs(chartData(scaled).max[1] - chartData(scaled).min[1]);
+    return chartData(padded).min;
 }
 
-float PackingChart::width(bool scaled) const
+const Mesh::TexCoord2D& PackingChart::max(bool padded) const
 {
-    return std::abs(chartData(scaled).max[0] - chartData(scaled).min[0]);
+    return chartData(padded).max;
 }
 
-size_t PackingChart::length(bool scaled) const
+Mesh::TexCoord2D PackingChart::extent() const
 {
-    return chartData(scaled).top.size();
+    const auto position = this->position(false);
+
+    return Mesh::TexCoord2D(position[0] + max(false)[0], position[1] + min(false)[1]);
 }
 
-const Mesh::TexCoord2D& PackingChart::min(bool scaled) const
+const PackingChart::Horizon& PackingChart::topHorizon(bool padded) const
 {
-    return chartData(scaled).min;
+    return chartData(padded).top;
 }
 
-const Mesh::TexCoord2D& PackingChart::max(bool scaled) const
+const PackingChart::Horizon& PackingChart::bottomHorizon(bool padded) const
 {
-    return chartData(scaled).max;
+    return chartData(padded).bottom;
 }
 
-const PackingChart::Horizon& PackingChart::topHorizon(bool scaled) const
+int PackingChart::turn() const
 {
-    return chartData(scaled).top;
+    return _turn;
 }
 
-const PackingChart::Horizon& PackingChart::bottomHorizon(bool scaled) const
+Mesh::TexCoord2D PackingChart::turnUV(const Mesh::TexCoord2D& uv) const
 {
-    return chartData(scaled).bottom;
+    return Turn(uv, _turn) + _offset;
 }
 
 void PackingChart::build(const Mesh* mesh)
 {
     auto& texCoords = _chart->texCoords();
 
-    _chartData.min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
-    _chartData.max = Mesh::TexCoord2D(FLT_MIN, FLT_MIN);
+    _edges.clear();
 
     for (const auto& edge : _chart->perimeterEdges())
     {
         auto to = mesh->property(texCoords, mesh->to_vertex_handle(mesh->halfedge_handle(edge, 0)));
         auto from = mesh->property(texCoords, mesh->from_vertex_handle(mesh->halfedge_handle(edge, 0)));
 
+        _edges.emplace_back(to, from);
+    }
+
+    setTurn(0);
+}
+
+void PackingChart::setTurn(int turn)
+{
+    _turn = turn;
+    _offset = Mesh::TexCoord2D(0, 0);
+
+    // Turned about the origin, then moved back so its corner stays where it
+    // was, which leaves the unturned chart exactly as it was
+    auto min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
+    auto turnedMin = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
+
+    for (const auto& edge : _edges)
+    {
+        min.minimize(edge.first);
+        min.minimize(edge.second);
+
+        turnedMin.minimize(Turn(edge.first, turn));
+        turnedMin.minimize(Turn(edge.second, turn));
+    }
+
+    if (!_edges.empty())
+    {
+        _offset = min - turnedMin;
+    }
+
+    _chartData.edges.clear();
+
+    _chartData.min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
+    _chartData.max = Mesh::TexCoord2D(FLT_MIN, FLT_MIN);
+
+    for (const auto& edge : _edges)
+    {
+        auto to = turnUV(edge.first);
+        auto from = turnUV(edge.second);
+
         if (to[0] > from[0])
         {
             std::swap(to, from);
@@ -94,107 +166,109 @@ void PackingChart::build(const Mesh* mesh)
         _chartData.max.maximize(from);
     }
 
-    scale(0);
+    _paddedChartData = _chartData;
 }
 
-bool intersection(const Mesh::TexCoord2D& origin, const Mesh::TexCoord2D& ray, const Mesh::TexCoord2D& a, const Mesh::TexCoord2D& b, float& t)
+Mesh::TexCoord2D PackingChart::Turn(const Mesh::TexCoord2D& uv, int turn)
 {
-    const auto v1 = origin - a;
-    const auto v2 = b - a;
-    const auto v3 = Mesh::TexCoord2D(-ray[1], ray[0]);
+    auto turned = turn >= 4 ? Mesh::TexCoord2D(-uv[0], uv[1]) : uv;
 
-    const auto dot = v2 | v3;
-    if (std::abs(dot) < FLT_EPSILON)
+    for (auto i = 0; i < turn % 4; i++)
     {
-        return false;
+        turned = Mesh::TexCoord2D(-turned[1], turned[0]);
     }
 
-    const auto t1 = ((v1[1] * v2[0] - (v1[0] * v2[1]))) / dot;
-    const auto t2 = (v1 | v3) / dot;
-
-    if (t1 >= 0 && (t2 >= 0 && t2 <= 1))
-    {
-        t = t1;
-        return true;
-    }
-
-    return false;
+    return turned;
 }
 
 void PackingChart::buildHorizons(float xStep, int padding)
 {
     buildHorizons(xStep, _chartData);
 
-    scale(xStep * (float)padding);
-    buildHorizons(xStep, _scaledChartData);
+    pad(xStep, padding);
 }
 
-void PackingChart::scale(float scale)
+void PackingChart::pad(float xStep, int padding)
 {
-    if (_scale == scale)
-    {
-        return;
-    }
+    const auto p = xStep * (float)padding;
 
-    _scaledChartData.edges.clear();
+    _paddedChartData.edges.clear();
 
-    const auto center = (_chartData.max + _chartData.min) / 2.0f;
+    _paddedChartData.min = _chartData.min - Mesh::TexCoord2D(p, p);
+    _paddedChartData.max = _chartData.max + Mesh::TexCoord2D(p, p);
 
-    scale = 1.0f + (scale / (center - _chartData.min).length());
+    // The outline grown by the padding on every side, which holds the chart
+    // whatever its shape: each column reaches as far as any column within
+    // the padding of it, and the padding further up and down. Heights are
+    // taken from the padded min, the padding below the chart.
+    const auto& top = _chartData.top;
+    const auto& bottom = _chartData.bottom;
+    const auto n = (int)top.size();
+    const auto size = n + 2 * padding;
 
-    _scaledChartData.min = Mesh::TexCoord2D(FLT_MAX, FLT_MAX);
-    _scaledChartData.max = Mesh::TexCoord2D(FLT_MIN, FLT_MIN);
+    _paddedChartData.top.assign(size, FLT_MAX);
+    _paddedChartData.bottom.assign(size, FLT_MIN);
 
-    for (const auto& edge : _chartData.edges)
+    for (auto i = 0; i < size; i++)
     {
-        const auto from = (edge.first - center) * scale;
-        const auto to = (edge.second - center) * scale;
-
-        _scaledChartData.edges.emplace_back(from, to);
-
-        _scaledChartData.min.minimize(to);
-        _scaledChartData.max.maximize(to);
-
-        _scaledChartData.min.minimize(from);
-        _scaledChartData.max.maximize(from);
+        for (auto j = std::max(i - 2 * padding, 0); j <= std::min(i, n - 1); j++)
+        {
+            _paddedChartData.top[i] = std::min(_paddedChartData.top[i], top[j]);
+            _paddedChartData.bottom[i] = std::max(_paddedChartData.bottom[i], bottom[j] + 2 * p);
+        }
     }
 }
 
 void PackingChart::buildHorizons(float xStep, Data &chartData)
 {
-    chartData.top.clear();
-    chartData.bottom.clear();
+    // The x where every column starts
+    std::vector<float> columns;
 
-    const auto originStart = Mesh::TexCoord2D(chartData.min[0], chartData.min[1]);
-    const auto originEnd = Mesh::TexCoord2D(chartData.max[0], chartData.min[1]);
-    const auto ray = Mesh::TexCoord2D(0, 1);
+    for (auto x = chartData.min[0]; x <= chartData.max[0]; x += xStep)
+    {
+        columns.push_back(x);
+    }
 
-    const auto step = Mesh::TexCoord2D(xStep, 0);
-    float t;
+    chartData.top.assign(columns.size(), FLT_MAX);
+    chartData.bottom.assign(columns.size(), FLT_MIN);
 
-    for (auto origin = originStart; origin[0] <= originEnd[0]; origin += step)
+    // Each column bounds the outline over its whole width, up to the next
+    // column, so a vertex between two columns cannot stand past them both
+    for (const auto& edge : chartData.edges)
     {
-        auto minT = FLT_MAX;
-        auto maxT = FLT_MIN;
+        const auto dx = edge.second[0] - edge.first[0];
+        const auto first = std::upper_bound(columns.begin(), columns.end(), edge.first[0]);
+        const auto last = std::upper_bound(first, columns.end(), edge.second[0]);
 
-        for (const auto& edge : chartData.edges)
+        for (auto column = first == columns.begin() ? first : first - 1; column != last; column++)
         {
-            if (edge.first[0] <= origin[0] && origin[0] <= edge.second[0])
+            const auto from = std::max(*column, edge.first[0]);
+            const auto to = std::min(*column + xStep, edge.second[0]);
+
+            if (from > to)
             {
-                if (intersection(origin, ray, edge.first, edge.second, t))
-                {
-                    minT = std::min(minT, t);
-                    maxT = std::max(maxT, t);
-                }
+                continue;
             }
-        }
 
-        chartData.top.push_back(minT);
-        chartData.bottom.push_back(maxT);
+            // The edge's height where it enters and leaves the column
+            auto y0 = edge.first[1];
+            auto y1 = edge.second[1];
+
+            if (dx > FLT_EPSILON)
+            {
+                y0 = edge.first[1] + (edge.second[1] - edge.first[1]) * ((from - edge.first[0]) / dx);
+                y1 = edge.first[1] + (edge.second[1] - edge.first[1]) * ((to - edge.first[0]) / dx);
+            }
+
+            const auto i = column - columns.begin();
+
+            chartData.top[i] = std::min(chartData.top[i], std::min(y0, y1) - chartData.min[1]);
+            chartData.bottom[i] = std::max(chartData.bottom[i], std::max(y0, y1) - chartData.min[1]);
+        }
     }
 }
 
-const PackingChart::Data& PackingChart::chartData(bool scaled) const
+const PackingChart::Data& PackingChart::chartData(bool padded) const
 {
-    return scaled ? _scaledChartData : _chartData;
+    return padded ? _paddedChartData : _chartData;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <vector>
 
+#include "../util/AlignedAllocator.h"
 #include "../util/MeshDef.h"
 #include "../charts/Chart.h"
 
@@ -13,7 +14,8 @@ class PackingChart
 public:
     typedef std::pair<Mesh::TexCoord2D, Mesh::TexCoord2D> UVEdge;
 
-    typedef std::vector<float> Horizon;
+    // Aligned for the vector kernels in HorizonKernels
+    typedef std::vector<float, AlignedAllocator<float>> Horizon;
 
 private:
     struct Data
@@ -31,10 +33,18 @@ private:
 
     Mesh::TexCoord2D _position;
 
+    int _page;
+
+    // Perimeter as parameterized, before turning
+    std::vector<UVEdge> _edges;
+
+    int _turn;
+    Mesh::TexCoord2D _offset;
+
     Data _chartData;
 
-    float _scale;
-    Data _scaledChartData;
+    // Horizons of the chart with its padding around it
+    Data _paddedChartData;
 
 public:
     PackingChart(const Chart *chart);
@@ -45,30 +55,51 @@ public:
 
     void setPosition(const Mesh::TexCoord2D &p);
 
-    Mesh::TexCoord2D position(bool scaled = true) const;
+    Mesh::TexCoord2D position(bool padded = true) const;
+
+    // Page of a multi-page atlas the chart is placed on, 0 otherwise
+    int page() const;
+
+    void setPage(int page);
 
-    float height(bool scaled = true) const;
+    float height(bool padded = true) const;
 
-    float width(bool scaled = true) const;
+    float width(bool padded = true) const;
 
-    size_t length(bool scaled = true) const;
+    size_t length(bool padded = true) const;
 
-    const Mesh::TexCoord2D &min(bool scaled = true) const;
+    const Mesh::TexCoord2D &min(bool padded = true) const;
 
-    const Mesh::TexCoord2D &max(bool scaled = true) const;
+    const Mesh::TexCoord2D &max(bool padded = true) const;
 
-    const Horizon &topHorizon(bool scaled = true) const;
+    // Far corner of the chart, without its padding, where it is placed
+    Mesh::TexCoord2D extent() const;
 
-    const Horizon &bottomHorizon(bool scaled = true) const;
+    const Horizon &topHorizon(bool padded = true) const;
+
+    const Horizon &bottomHorizon(bool padded = true) const;
+
+    // Quarter turns counter-clockwise, plus 4 when mirrored in x first
+    int turn() const;
+
+    // Where a UV of the chart lies once the chart is turned
+    Mesh::TexCoord2D turnUV(const Mesh::TexCoord2D& uv) const;
 
     void build(const Mesh *mesh);
 
+    void setTurn(int turn);
+
+    // Top and bottom of the chart in every column of the step, each bounding
+    // the outline over the column's whole width rather than at one x, then
+    // the same grown by the padding on every side
     void buildHorizons(float step, int padding);
 
 private:
-    const Data &chartData(bool scaled) const;
+    static Mesh::TexCoord2D Turn(const Mesh::TexCoord2D& uv, int turn);
+
+    const Data &chartData(bool padded) const;
 
-    void scale(float scale);
+    void pad(float xStep, int padding);
 
     void buildHorizons(float xStep, Data &chartData);
 };
@@ -0,0 +1,38 @@
+//
+//  PackingCutoff.cpp
+//  LSCM
+//
+
+#include "PackingCutoff.h"
+
+#include <cfloat>
+
+PackingCutoff::PackingCutoff()
+: deadline(Clock::time_point::max())
+, maxArea(FLT_MAX)
+{
+}
+
+void PackingCutoff::setBudget(double seconds)
+{
+    deadline = seconds > 0
+        ? Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds))
+        : Clock::time_point::max();
+}
+
+void PackingCutoff::offer(const Mesh::TexCoord2D& extent)
+{
+    const auto area = extent[0] * extent[1];
+
+    auto current = maxArea.load();
+
+    while (area < current && !maxArea.compare_exchange_weak(current, area))
+    {
+    }
+}
+
+bool PackingCutoff::reached(const Mesh::TexCoord2D& extent) const
+{
+    // Layouts of equal extent tie, and still finish
+    return extent[0] * extent[1] > maxArea || Clock::now() > deadline;
+}
@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "../util/MeshDef.h"
+
+// When the packs of a portfolio give up: once past the deadline, or once the
+// charts they placed reach an extent larger than a layout packed already,
+// so they cannot use the atlas any better.
+struct PackingCutoff
+{
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::time_point deadline;
+
+    // Area of the smallest extent packed in full
+    std::atomic<float> maxArea;
+
+    PackingCutoff();
+
+    // With no deadline unless one is set
+    void setBudget(double seconds);
+
+    // Lowers the area to a layout's extent, if smaller
+    void offer(const Mesh::TexCoord2D& extent);
+
+    // Whether a pack whose charts reach this far should give up
+    bool reached(const Mesh::TexCoord2D& extent) const;
+};
@@ -0,0 +1,233 @@
+//
+//  PackingLayout.cpp
+//  LSCM
+//
+//  The file holds a version tag, the atlas, the engine state, then each
+//  placement with its full key, as ResultCache stores keys. It is written
+//  under a temporary name and renamed, as the layout it replaces may be
+//  the one read.
+//
+
+#include "PackingLayout.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+// "LSCMPL01" in little endian
+const uint64_t FILE_TAG = 0x31304c504d43534cull;
+
+namespace
+{
+    template<typename T>
+    void Write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T, typename A>
+    void Write(std::ostream& out, const std::vector<T, A>& values)
+    {
+        Write(out, (uint64_t)values.size());
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    bool Read(std::istream& in, T& value)
+    {
+        return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    // Only reads as many values as the file could hold, so a damaged file
+    // fails instead of allocating whatever its size field says
+    template<typename T, typename A>
+    bool Read(std::istream& in, std::vector<T, A>& values, uint64_t fileSize)
+    {
+        uint64_t size = 0;
+
+        if (!Read(in, size) || size > fileSize / sizeof(T))
+        {
+            return false;
+        }
+
+        values.resize(size);
+
+        return (bool)in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+    }
+
+    void Write(std::ostream& out, const Bitmap& bitmap)
+    {
+        Write(out, (int32_t)bitmap.width());
+        Write(out, (int32_t)bitmap.height());
+
+        for (auto y = 0; y < bitmap.height(); y++)
+        {
+            for (auto x = 0; x < bitmap.width(); x += 64)
+            {
+                Write(out, bitmap.word(x, y));
+            }
+        }
+    }
+
+    bool Read(std::istream& in, Bitmap& bitmap, uint64_t fileSize)
+    {
+        int32_t width = 0;
+        int32_t height = 0;
+
+        if (!Read(in, width) || !Read(in, height) || width < 0 || height < 0 || (uint64_t)(width + 63) / 64 * height > fileSize / 8)
+        {
+            return false;
+        }
+
+        bitmap = Bitmap(width, height);
+
+        for (auto y = 0; y < height; y++)
+        {
+            for (auto x = 0; x < width; x += 64)
+            {
+                uint64_t bits = 0;
+
+                if (!Read(in, bits))
+                {
+                    return false;
+                }
+
+                bitmap.mergeWord(bits, x, y);
+            }
+        }
+
+        return true;
+    }
+}
+
+PackingLayout::PackingLayout()
+: resolution(0)
+, padding(0)
+, density(0)
+, dimension(0)
+, extent(0, 0)
+{
+}
+
+bool PackingLayout::Read(const std::string& path, PackingLayout& layout)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    const auto fileSize = (uint64_t)in.tellg();
+    in.seekg(0);
+
+    uint64_t tag = 0;
+    uint64_t numHorizons = 0;
+    uint64_t numPlacements = 0;
+
+    auto valid = ::Read(in, tag) && tag == FILE_TAG
+        && ::Read(in, layout.resolution) && ::Read(in, layout.padding) && ::Read(in, layout.density)
+        && ::Read(in, layout.dimension) && ::Read(in, layout.extent)
+        && ::Read(in, numHorizons) && numHorizons <= fileSize;
+
+    layout.horizons.clear();
+
+    for (uint64_t i = 0; valid && i < numHorizons; i++)
+    {
+        layout.horizons.emplace_back();
+        valid = ::Read(in, layout.horizons.back(), fileSize);
+    }
+
+    valid = valid && ::Read(in, layout.occupancy, fileSize) && ::Read(in, numPlacements) && numPlacements <= fileSize;
+
+    layout.placements.clear();
+
+    for (uint64_t i = 0; valid && i < numPlacements; i++)
+    {
+        layout.placements.emplace_back();
+
+        auto& placement = layout.placements.back();
+        auto& key = placement.key;
+
+        valid = ::Read(in, key.numVertices) && ::Read(in, key.meanLength) && ::Read(in, key.hash)
+            && ::Read(in, key.faces, fileSize) && ::Read(in, key.lengths, fileSize)
+            && ::Read(in, placement.center) && ::Read(in, placement.page)
+            && ::Read(in, placement.uvs, fileSize) && placement.uvs.size() == key.numVertices;
+    }
+
+    if (!valid || !(layout.resolution >= 1))
+    {
+        return false;
+    }
+
+    // A later run indexes its pages by these and restores each horizon into
+    // an atlas of the resolution, so anything past them is damage
+    for (const auto& horizon : layout.horizons)
+    {
+        if (horizon.size() > (size_t)layout.resolution)
+        {
+            return false;
+        }
+    }
+
+    const auto numPages = std::max((int)layout.horizons.size(), 1);
+
+    for (const auto& placement : layout.placements)
+    {
+        if (placement.page < 0 || placement.page >= numPages)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PackingLayout::Write(const std::string& path, const PackingLayout& layout)
+{
+    const auto temporary = path + ".tmp";
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+        ::Write(out, FILE_TAG);
+        ::Write(out, layout.resolution);
+        ::Write(out, layout.padding);
+        ::Write(out, layout.density);
+        ::Write(out, layout.dimension);
+        ::Write(out, layout.extent);
+
+        ::Write(out, (uint64_t)layout.horizons.size());
+
+        for (const auto& horizon : layout.horizons)
+        {
+            ::Write(out, horizon);
+        }
+
+        ::Write(out, layout.occupancy);
+
+        ::Write(out, (uint64_t)layout.placements.size());
+
+        for (const auto& placement : layout.placements)
+        {
+            const auto& key = placement.key;
+
+            ::Write(out, key.numVertices);
+            ::Write(out, key.meanLength);
+            ::Write(out, key.hash);
+            ::Write(out, key.faces);
+            ::Write(out, key.lengths);
+            ::Write(out, placement.center);
+            ::Write(out, placement.page);
+            ::Write(out, placement.uvs);
+        }
+
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
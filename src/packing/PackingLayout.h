@@ -0,0 +1,52 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/IntrinsicKey.h"
+#include "../util/MeshDef.h"
+#include "Bitmap.h"
+#include "PackingChart.h"
+
+// An atlas as packed and applied: the charts' final UVs and the state of the
+// engine that packed them, so a later run can keep those charts where they
+// are and pack new ones into the space left around them.
+struct PackingLayout
+{
+    struct Placement
+    {
+        // Identifies the chart in a later run, the centre telling identical
+        // copies apart
+        IntrinsicKey key;
+        Mesh::Point center;
+
+        int page;
+
+        // Final UVs in the order of the chart's vertex list
+        std::vector<Mesh::TexCoord2D> uvs;
+    };
+
+    float resolution;
+    int padding;
+
+    // Texels per unit of pages, 0 for a single atlas
+    float density;
+
+    // Of the atlas in chart units, and the extent its UVs are scaled from
+    float dimension;
+    Mesh::TexCoord2D extent;
+
+    // One horizon per page when packed by the horizon engine, or the texels
+    // covered when packed by the occupancy engine
+    std::vector<PackingChart::Horizon> horizons;
+    Bitmap occupancy;
+
+    std::vector<Placement> placements;
+
+    PackingLayout();
+
+    // False if the file is missing or damaged
+    static bool Read(const std::string& path, PackingLayout& layout);
+    static bool Write(const std::string& path, const PackingLayout& layout);
+};
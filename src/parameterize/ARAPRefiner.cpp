@@ -0,0 +1,365 @@
+//
+//  ARAPRefiner.cpp
+//  LSCM
+//
+//  Referenced:
+//  A Local/Global Approach to Mesh Parameterization - Liu et al
+//  https://cs.harvard.edu/~sjg/papers/arap.pdf
+//
+//  Each chart's faces are gathered into flat arrays once. The local step
+//  fits every face's rotation in closed form, in a loop without branches
+//  so it vectorizes. Charts are independent and refined in parallel.
+//
+
+#include "ARAPRefiner.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+
+// Stops iterating once an iteration lowers the energy by less than this fraction
+const double ENERGY_TOLERANCE = 0.0001;
+
+// Charts with less energy than this, relative to their area, are already isometric
+const double ISOMETRIC_ENERGY = 0.00000001;
+
+// Faces with less than this fraction of the chart's mean area get no weight
+const double DEGENERATE_AREA = 0.000001;
+
+namespace
+{
+    // Edge e of a face runs from its corner e + 1 to its corner e, opposite
+    // corner e + 2, with its vector in the face frame and the cotangent of
+    // the opposite angle as its weight
+    struct FaceArrays
+    {
+        std::array<std::vector<int>, 3> corners;
+        std::array<std::vector<double>, 3> dx;
+        std::array<std::vector<double>, 3> dy;
+        std::array<std::vector<double>, 3> weights;
+
+        std::vector<double> c;
+        std::vector<double> s;
+
+        void resize(size_t numFaces)
+        {
+            for (auto e = 0; e < 3; e++)
+            {
+                corners[e].resize(numFaces);
+                dx[e].resize(numFaces);
+                dy[e].resize(numFaces);
+                weights[e].resize(numFaces);
+            }
+
+            c.resize(numFaces);
+            s.resize(numFaces);
+        }
+    };
+
+    // Fits the rotation closest to each face's Jacobian, and returns the
+    // energy left with those rotations
+    double FitRotations(FaceArrays& faces, const MatrixX& uv)
+    {
+        const auto numFaces = (std::ptrdiff_t)faces.c.size();
+
+        const auto* u = uv.col(0).data();
+        const auto* v = uv.col(1).data();
+
+        const int* corners[3] = {faces.corners[0].data(), faces.corners[1].data(), faces.corners[2].data()};
+        const double* dxs[3] = {faces.dx[0].data(), faces.dx[1].data(), faces.dx[2].data()};
+        const double* dys[3] = {faces.dy[0].data(), faces.dy[1].data(), faces.dy[2].data()};
+        const double* weights[3] = {faces.weights[0].data(), faces.weights[1].data(), faces.weights[2].data()};
+
+        auto* c = faces.c.data();
+        auto* s = faces.s.data();
+
+        auto energy = 0.0;
+
+        #pragma omp simd reduction(+:energy)
+        for (std::ptrdiff_t f = 0; f < numFaces; f++)
+        {
+            auto s00 = 0.0, s01 = 0.0, s10 = 0.0, s11 = 0.0;
+            auto squares = 0.0;
+
+            for (auto e = 0; e < 3; e++)
+            {
+                const auto a = corners[e][f];
+                const auto b = corners[(e + 1) % 3][f];
+                const auto w = weights[e][f];
+                const auto dx = dxs[e][f];
+                const auto dy = dys[e][f];
+
+                const auto du = u[a] - u[b];
+                const auto dv = v[a] - v[b];
+
+                s00 += w * du * dx;
+                s01 += w * du * dy;
+                s10 += w * dv * dx;
+                s11 += w * dv * dy;
+
+                squares += w * (du * du + dv * dv + dx * dx + dy * dy);
+            }
+
+            // The rotation maximizing tr(RᵀS)
+            const auto p = s00 + s11;
+            const auto q = s10 - s01;
+            const auto h = std::sqrt(p * p + q * q);
+
+            c[f] = h > 0 ? p / h : 1.0;
+            s[f] = h > 0 ? q / h : 0.0;
+
+            energy += squares - 2.0 * h;
+        }
+
+        return energy;
+    }
+}
+
+ARAPRefiner::ARAPRefiner(Mesh* mesh, const std::vector<Chart>* charts, const FaceFrames* frames)
+: _mesh(mesh)
+, _charts(charts)
+, _frames(frames)
+, _iterations(10)
+{
+}
+
+void ARAPRefiner::setIterations(size_t iterations)
+{
+    _iterations = iterations;
+}
+
+void ARAPRefiner::refine()
+{
+    std::cout << "Refining Charts..." << std::endl;
+
+    const auto numCharts = (std::ptrdiff_t)_charts->size();
+
+    _refinements.resize(numCharts);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (std::ptrdiff_t i = 0; i < numCharts; i++)
+    {
+        refine((*_charts)[i], _refinements[i]);
+    }
+
+    auto iterations = 0;
+    auto seconds = 0.0;
+
+    for (const auto& refinement : _refinements)
+    {
+        std::cout << "Chart: " << refinement.id << std::endl;
+
+        if (!refinement.refined)
+        {
+            std::cout << "\t*Not refined" << std::endl;
+            continue;
+        }
+
+        std::cout << "\tIterations: " << refinement.iterations << std::endl
+            << "\tTime per iteration: " << refinement.seconds * 1000.0 / std::max<size_t>(refinement.iterations, 1) << "ms" << std::endl
+            << "\tEnergy: " << refinement.initialEnergy << " -> " << refinement.energy << std::endl;
+
+        iterations += refinement.iterations;
+        seconds += refinement.seconds;
+    }
+
+    std::cout << "Time per iteration: " << seconds * 1000.0 / std::max(iterations, 1) << "ms" << std::endl;
+}
+
+const std::vector<ChartRefinement>& ARAPRefiner::refinements() const
+{
+    return _refinements;
+}
+
+void ARAPRefiner::refine(const Chart& chart, ChartRefinement& refinement) const
+{
+    const auto& faces = chart.faces();
+    const auto& vertices = chart.vertices();
+    const auto& texCoords = chart.texCoords();
+
+    const auto numFaces = faces.size();
+    const auto numVertices = vertices.size();
+
+    refinement = ChartRefinement();
+    refinement.id = chart.id();
+
+    if (numFaces == 0 || _iterations == 0)
+    {
+        return;
+    }
+
+    std::map<Mesh::VertexHandle, int> local;
+    MatrixX uv(numVertices, 2);
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        local[vertices[i]] = i;
+
+        const auto& texCoord = _mesh->property(texCoords, vertices[i]);
+        uv(i, 0) = texCoord[0];
+        uv(i, 1) = texCoord[1];
+    }
+
+    FaceArrays arrays;
+    arrays.resize(numFaces);
+
+    auto surfaceArea = 0.0;
+
+    for (const auto& face : faces)
+    {
+        surfaceArea += _frames->area(face);
+    }
+
+    const auto minArea = DEGENERATE_AREA * surfaceArea / numFaces;
+
+    TripletList triplets;
+    triplets.reserve(numFaces * 12 + 1);
+
+    Mesh::Point pv[3];
+
+    for (auto f = 0; f < numFaces; f++)
+    {
+        auto i = 0;
+        auto fv_it = _mesh->cfv_begin(faces[f]), fv_end = _mesh->cfv_end(faces[f]);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            arrays.corners[i][f] = local.at(*fv_it);
+        }
+
+        _frames->project(faces[f], pv);
+
+        const auto area = (double)_frames->area(faces[f]);
+
+        for (auto e = 0; e < 3; e++)
+        {
+            const auto& pa = pv[e];
+            const auto& pb = pv[(e + 1) % 3];
+            const auto& pk = pv[(e + 2) % 3];
+
+            const auto ka = pa - pk;
+            const auto kb = pb - pk;
+
+            const auto w = area > minArea ? (ka | kb) / (2.0 * area) : 0.0;
+
+            arrays.dx[e][f] = pa[0] - pb[0];
+            arrays.dy[e][f] = pa[1] - pb[1];
+            arrays.weights[e][f] = w;
+
+            const auto a = arrays.corners[e][f];
+            const auto b = arrays.corners[(e + 1) % 3][f];
+
+            triplets.emplace_back(a, a, w);
+            triplets.emplace_back(b, b, w);
+            triplets.emplace_back(a, b, -w);
+            triplets.emplace_back(b, a, -w);
+        }
+    }
+
+    // Pins the first vertex where it is. The Laplacian's rows and every
+    // right hand side sum to zero, so this holds it exactly.
+    triplets.emplace_back(0, 0, 1.0);
+
+    SparseMatrix laplacian(numVertices, numVertices);
+    laplacian.setFromTriplets(triplets.begin(), triplets.end());
+
+    // The conformal map has an arbitrary scale, and starts at the one
+    // closest to the surface
+    auto uvArea = 0.0;
+
+    for (auto f = 0; f < numFaces; f++)
+    {
+        const auto a = uv.row(arrays.corners[0][f]);
+        const auto b = uv.row(arrays.corners[1][f]);
+        const auto c = uv.row(arrays.corners[2][f]);
+
+        uvArea += 0.5 * ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]));
+    }
+
+    if (!(uvArea > 0) || !(surfaceArea > 0))
+    {
+        return;
+    }
+
+    const Eigen::RowVector2d center = uv.colwise().mean();
+    uv = ((uv.rowwise() - center) * std::sqrt(surfaceArea / uvArea)).eval();
+
+    Eigen::SimplicialLDLT<SparseMatrix> solver(laplacian);
+
+    if (solver.info() != Eigen::Success)
+    {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    MatrixX rhs(numVertices, 2);
+
+    auto energy = FitRotations(arrays, uv);
+    refinement.initialEnergy = energy / surfaceArea;
+
+    for (refinement.iterations = 0; refinement.iterations < _iterations && energy >= ISOMETRIC_ENERGY * surfaceArea; refinement.iterations++)
+    {
+        rhs.setZero();
+        rhs.row(0) = uv.row(0);
+
+        for (auto f = 0; f < numFaces; f++)
+        {
+            const auto c = arrays.c[f];
+            const auto s = arrays.s[f];
+
+            for (auto e = 0; e < 3; e++)
+            {
+                const auto w = arrays.weights[e][f];
+                const auto dx = arrays.dx[e][f];
+                const auto dy = arrays.dy[e][f];
+
+                const auto ru = w * (c * dx - s * dy);
+                const auto rv = w * (s * dx + c * dy);
+
+                const auto a = arrays.corners[e][f];
+                const auto b = arrays.corners[(e + 1) % 3][f];
+
+                rhs(a, 0) += ru;
+                rhs(a, 1) += rv;
+                rhs(b, 0) -= ru;
+                rhs(b, 1) -= rv;
+            }
+        }
+
+        uv = solver.solve(rhs);
+
+        const auto previous = energy;
+        energy = FitRotations(arrays, uv);
+
+        if (previous - energy < ENERGY_TOLERANCE * previous || energy < ISOMETRIC_ENERGY * surfaceArea)
+        {
+            refinement.iterations++;
+            break;
+        }
+    }
+
+    refinement.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    refinement.energy = energy / surfaceArea;
+
+    // Keeps the conformal map when the iterations diverged
+    if (!uv.allFinite() || !(refinement.energy <= refinement.initialEnergy))
+    {
+        return;
+    }
+
+    refinement.refined = true;
+
+    const Eigen::RowVector2d minUV = uv.colwise().minCoeff();
+    const Eigen::RowVector2d maxUV = uv.colwise().maxCoeff();
+    const auto length = (maxUV - minUV).maxCoeff();
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        const auto nuv = Mesh::TexCoord2D((uv(i, 0) - minUV[0]) / length, (uv(i, 1) - minUV[1]) / length);
+
+        _mesh->property(texCoords, vertices[i]) = nuv;
+        _mesh->set_texcoord2D(vertices[i], nuv);
+    }
+}
@@ -0,0 +1,58 @@
+
+#pragma once
+
+#include <vector>
+
+#include "../util/MatrixDef.h"
+
+#include "../util/MeshDef.h"
+#include "../util/FaceFrames.h"
+
+#include "../charts/Chart.h"
+
+using namespace Charts;
+
+// Outcome of refining a chart, with energies relative to the chart's
+// surface area
+struct ChartRefinement
+{
+    size_t id;
+
+    size_t iterations;
+    double seconds;
+
+    double initialEnergy;
+    double energy;
+
+    bool refined;
+};
+
+// Refines the UVs of each chart toward an isometry with local/global
+// as-rigid-as-possible iterations, starting from its conformal map. The
+// chart's cotangent Laplacian is factored once, and every iteration fits a
+// rotation to each face then solves for the UVs with that factorization.
+class ARAPRefiner
+{
+private:
+    Mesh* _mesh;
+    const std::vector<Chart>* _charts;
+    const FaceFrames* _frames;
+
+    size_t _iterations;
+
+    std::vector<ChartRefinement> _refinements;
+
+public:
+    ARAPRefiner(Mesh* mesh, const std::vector<Chart>* charts, const FaceFrames* frames);
+
+    // Most iterations run on each chart, stopping early once the energy
+    // stops decreasing
+    void setIterations(size_t iterations);
+
+    void refine();
+
+    const std::vector<ChartRefinement>& refinements() const;
+
+private:
+    void refine(const Chart& chart, ChartRefinement& refinement) const;
+};
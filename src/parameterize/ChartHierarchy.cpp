@@ -0,0 +1,277 @@
+//
+//  ChartHierarchy.cpp
+//  LSCM
+//
+//  Coarsens a chart by repeatedly collapsing independent sets of short
+//  edges. Pinned vertices are never removed and boundary vertices are only
+//  collapsed along nearly straight stretches of the outline, so every level
+//  keeps the anchors and the shape of the chart.
+//
+
+#include "ChartHierarchy.h"
+
+#include <map>
+
+#include "../util/MeshUtil.h"
+
+const float MIN_REDUCTION = 0.05f;
+const float MIN_NORMAL_COS = 0.2f;
+const float MIN_BOUNDARY_COS = 0.95f;
+
+ChartHierarchy::ChartHierarchy(const std::vector<Mesh::Point>* points, const FaceArray& faces, const std::vector<size_t>& pinned)
+: _points(points)
+, _pinned(points->size(), false)
+{
+    for (const auto& vertex : pinned)
+    {
+        _pinned[vertex] = true;
+    }
+
+    _levels.emplace_back();
+    _levels.back().faces = faces;
+}
+
+const std::vector<ChartHierarchy::Level>& ChartHierarchy::levels() const
+{
+    return _levels;
+}
+
+size_t ChartHierarchy::numVertices() const
+{
+    return _points->size();
+}
+
+void ChartHierarchy::build(size_t minFaces)
+{
+    _levels.resize(1);
+    _levels.front().collapses.clear();
+
+    while (_levels.back().faces.size() > minFaces)
+    {
+        Level coarse;
+
+        if (!coarsen(_levels.back(), coarse))
+        {
+            break;
+        }
+
+        const auto fineSize = (float)_levels.back().faces.size();
+        const auto coarseSize = (float)coarse.faces.size();
+
+        _levels.push_back(std::move(coarse));
+
+        if (coarseSize > fineSize * (1.0f - MIN_REDUCTION))
+        {
+            break;
+        }
+    }
+}
+
+bool ChartHierarchy::coarsen(Level& fine, Level& coarse)
+{
+    const auto& points = *_points;
+    const auto& faces = fine.faces;
+
+    std::vector<std::vector<size_t>> vertexFaces(points.size());
+    std::map<std::pair<size_t, size_t>, int> edgeFaces;
+
+    for (auto i = 0; i < faces.size(); i++)
+    {
+        const auto& face = faces[i];
+
+        for (auto k = 0; k < 3; k++)
+        {
+            const auto a = face[k];
+            const auto b = face[(k + 1) % 3];
+
+            vertexFaces[a].push_back(i);
+            edgeFaces[{std::min(a, b), std::max(a, b)}]++;
+        }
+    }
+
+    std::vector<std::vector<size_t>> boundary(points.size());
+    std::vector<std::pair<float, std::pair<size_t, size_t>>> edges;
+    edges.reserve(edgeFaces.size());
+
+    for (const auto& edge : edgeFaces)
+    {
+        const auto a = edge.first.first;
+        const auto b = edge.first.second;
+
+        if (edge.second == 1)
+        {
+            boundary[a].push_back(b);
+            boundary[b].push_back(a);
+        }
+
+        edges.emplace_back((points[a] - points[b]).sqrnorm(), edge.first);
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    std::vector<bool> touched(points.size(), false);
+    std::vector<size_t> target(points.size());
+
+    for (auto i = 0; i < target.size(); i++)
+    {
+        target[i] = i;
+    }
+
+    for (const auto& edge : edges)
+    {
+        const size_t ends[2] = {edge.second.first, edge.second.second};
+
+        for (auto k = 0; k < 2; k++)
+        {
+            const auto from = ends[k];
+            const auto to = ends[1 - k];
+
+            if (touched[from] || touched[to] || _pinned[from])
+            {
+                continue;
+            }
+
+            const auto& outline = boundary[from];
+
+            if (!outline.empty())
+            {
+                // Only slide along the outline, and only where it is straight
+                if (outline.size() != 2 || (outline[0] != to && outline[1] != to))
+                {
+                    continue;
+                }
+
+                const auto other = outline[0] == to ? outline[1] : outline[0];
+                const auto d0 = (points[from] - points[other]).normalized();
+                const auto d1 = (points[to] - points[from]).normalized();
+
+                if ((d0 | d1) < MIN_BOUNDARY_COS)
+                {
+                    continue;
+                }
+            }
+            else if (!boundary[to].empty() && edgeFaces[{std::min(from, to), std::max(from, to)}] == 1)
+            {
+                continue;
+            }
+
+            if (!canCollapse(from, to, !outline.empty(), vertexFaces, faces))
+            {
+                continue;
+            }
+
+            Collapse collapse;
+            collapse.vertex = from;
+
+            for (const auto& f : vertexFaces[from])
+            {
+                for (const auto& vertex : faces[f])
+                {
+                    if (vertex != from)
+                    {
+                        collapse.ring.push_back(vertex);
+                    }
+                }
+            }
+
+            MeshUtil::Unique(collapse.ring);
+
+            touched[from] = true;
+            for (const auto& vertex : collapse.ring)
+            {
+                touched[vertex] = true;
+            }
+
+            target[from] = to;
+
+            fine.collapses.push_back(std::move(collapse));
+            break;
+        }
+    }
+
+    if (fine.collapses.empty())
+    {
+        return false;
+    }
+
+    coarse.faces.reserve(faces.size());
+
+    for (const auto& face : faces)
+    {
+        const Face mapped = {target[face[0]], target[face[1]], target[face[2]]};
+
+        if (mapped[0] == mapped[1] || mapped[1] == mapped[2] || mapped[2] == mapped[0])
+        {
+            continue;
+        }
+
+        coarse.faces.push_back(mapped);
+    }
+
+    return true;
+}
+
+bool ChartHierarchy::canCollapse(size_t from, size_t to, bool isBoundary, const std::vector<std::vector<size_t>>& vertexFaces, const FaceArray& faces) const
+{
+    const auto& points = *_points;
+
+    // Link condition: an edge may only share the vertices opposite it,
+    // otherwise the collapse creates non-manifold geometry.
+    std::vector<size_t> fromRing;
+    std::vector<size_t> toRing;
+
+    for (const auto& f : vertexFaces[from])
+    {
+        fromRing.insert(fromRing.end(), faces[f].begin(), faces[f].end());
+    }
+
+    for (const auto& f : vertexFaces[to])
+    {
+        toRing.insert(toRing.end(), faces[f].begin(), faces[f].end());
+    }
+
+    MeshUtil::Unique(fromRing);
+    MeshUtil::Unique(toRing);
+
+    std::vector<size_t> shared;
+    std::set_intersection(fromRing.begin(), fromRing.end(), toRing.begin(), toRing.end(), std::back_inserter(shared));
+
+    // Shared also holds both ends of the edge
+    if (shared.size() != (isBoundary ? 3 : 4))
+    {
+        return false;
+    }
+
+    // Reject collapses that fold or degenerate the surrounding faces
+    for (const auto& f : vertexFaces[from])
+    {
+        const auto& face = faces[f];
+
+        if (face[0] == to || face[1] == to || face[2] == to)
+        {
+            continue;
+        }
+
+        Mesh::Point before[3];
+        Mesh::Point after[3];
+
+        for (auto k = 0; k < 3; k++)
+        {
+            before[k] = points[face[k]];
+            after[k] = face[k] == from ? points[to] : before[k];
+        }
+
+        const auto n0 = (before[1] - before[0]) % (before[2] - before[0]);
+        const auto n1 = (after[1] - after[0]) % (after[2] - after[0]);
+
+        const auto l0 = n0.norm();
+        const auto l1 = n1.norm();
+
+        if (l1 <= FLT_EPSILON * l0 || (n0 | n1) < MIN_NORMAL_COS * l0 * l1)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
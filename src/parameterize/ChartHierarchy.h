@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "../util/MeshDef.h"
+
+class ChartHierarchy
+{
+public:
+    typedef std::array<size_t, 3> Face;
+    typedef std::vector<Face> FaceArray;
+
+    // A vertex removed while coarsening, along with the neighbors it
+    // was interpolated from.
+    struct Collapse
+    {
+        size_t vertex;
+        std::vector<size_t> ring;
+    };
+
+    struct Level
+    {
+        FaceArray faces;
+
+        // Vertices removed when moving to the next coarser level
+        std::vector<Collapse> collapses;
+    };
+
+private:
+    const std::vector<Mesh::Point>* _points;
+
+    std::vector<bool> _pinned;
+
+    std::vector<Level> _levels;
+
+public:
+    ChartHierarchy(const std::vector<Mesh::Point>* points, const FaceArray& faces, const std::vector<size_t>& pinned);
+
+    const std::vector<Level>& levels() const;
+
+    size_t numVertices() const;
+
+    void build(size_t minFaces);
+
+private:
+    bool coarsen(Level& fine, Level& coarse);
+
+    bool canCollapse(size_t from, size_t to, bool isBoundary, const std::vector<std::vector<size_t>>& vertexFaces, const FaceArray& faces) const;
+};
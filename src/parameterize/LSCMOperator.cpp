@@ -0,0 +1,166 @@
+//
+//  LSCMOperator.cpp
+//  LSCM
+//
+//  Each face keeps the columns of its vertices and its projected
+//  coefficients, two rows of A apiece, and products are gathered face by
+//  face. The diagonal of AᵀA is summed the same way for the preconditioner.
+//
+
+#include "LSCMOperator.h"
+
+const size_t LSCMOperator::FIXED = (size_t)-1;
+
+LSCMOperator::LSCMOperator()
+: _numColumns(0)
+{
+}
+
+void LSCMOperator::resize(size_t numFaces, size_t numColumns)
+{
+    _faces.resize(numFaces);
+    _numColumns = numColumns;
+}
+
+void LSCMOperator::setFace(size_t index, const size_t* columns, const double* re, const double* im)
+{
+    auto& face = _faces[index];
+
+    for (auto i = 0; i < 3; i++)
+    {
+        face.columns[i] = columns[i];
+        face.re[i] = re[i];
+        face.im[i] = im[i];
+    }
+}
+
+Eigen::Index LSCMOperator::rows() const
+{
+    return _numColumns;
+}
+
+Eigen::Index LSCMOperator::cols() const
+{
+    return _numColumns;
+}
+
+size_t LSCMOperator::numFaces() const
+{
+    return _faces.size();
+}
+
+void LSCMOperator::apply(const MatrixXx1& x, MatrixXx1& y) const
+{
+    y.resize(_faces.size() * 2);
+
+    for (auto f = 0; f < _faces.size(); f++)
+    {
+        const auto& face = _faces[f];
+
+        auto real = 0.0;
+        auto imaginary = 0.0;
+
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto u = face.columns[i];
+
+            if (u == FIXED)
+            {
+                continue;
+            }
+
+            real += face.re[i] * x[u] + face.im[i] * x[u + 1];
+            imaginary += -face.im[i] * x[u] + face.re[i] * x[u + 1];
+        }
+
+        y[f * 2] = real;
+        y[f * 2 + 1] = imaginary;
+    }
+}
+
+void LSCMOperator::applyTranspose(const MatrixXx1& y, MatrixXx1& x) const
+{
+    x.resize(_numColumns);
+    x.setZero();
+
+    for (auto f = 0; f < _faces.size(); f++)
+    {
+        const auto& face = _faces[f];
+
+        const auto real = y[f * 2];
+        const auto imaginary = y[f * 2 + 1];
+
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto u = face.columns[i];
+
+            if (u == FIXED)
+            {
+                continue;
+            }
+
+            x[u] += face.re[i] * real - face.im[i] * imaginary;
+            x[u + 1] += face.im[i] * real + face.re[i] * imaginary;
+        }
+    }
+}
+
+void LSCMOperator::diagonal(MatrixXx1& d) const
+{
+    d.resize(_numColumns);
+    d.setZero();
+
+    for (const auto& face : _faces)
+    {
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto u = face.columns[i];
+
+            if (u == FIXED)
+            {
+                continue;
+            }
+
+            const auto value = face.re[i] * face.re[i] + face.im[i] * face.im[i];
+
+            d[u] += value;
+            d[u + 1] += value;
+        }
+    }
+}
+
+LSCMPreconditioner::LSCMPreconditioner()
+{
+}
+
+LSCMPreconditioner& LSCMPreconditioner::analyzePattern(const LSCMOperator&)
+{
+    return *this;
+}
+
+LSCMPreconditioner& LSCMPreconditioner::factorize(const LSCMOperator& op)
+{
+    op.diagonal(_invDiagonal);
+
+    for (auto i = 0; i < _invDiagonal.size(); i++)
+    {
+        _invDiagonal[i] = _invDiagonal[i] > 0 ? 1.0 / _invDiagonal[i] : 1.0;
+    }
+
+    return *this;
+}
+
+LSCMPreconditioner& LSCMPreconditioner::compute(const LSCMOperator& op)
+{
+    return factorize(op);
+}
+
+MatrixXx1 LSCMPreconditioner::solve(const MatrixXx1& b) const
+{
+    return _invDiagonal.cwiseProduct(b);
+}
+
+Eigen::ComputationInfo LSCMPreconditioner::info() const
+{
+    return Eigen::Success;
+}
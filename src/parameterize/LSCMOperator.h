@@ -0,0 +1,169 @@
+//
+//  LSCMOperator.h
+//  LSCM
+//
+//  A chart's LSCM normal operator and its Jacobi preconditioner, shaped for
+//  Eigen's iterative solvers so charts can be solved without assembling
+//  the sparse matrix.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "../util/MatrixDef.h"
+
+class LSCMOperator;
+
+namespace Eigen
+{
+namespace internal
+{
+    template<>
+    struct traits<LSCMOperator> : public Eigen::internal::traits<::SparseMatrix>
+    {
+    };
+}
+}
+
+// The normal operator AᵀA of a chart's LSCM system, applied face by face
+// from the projected coefficients instead of an assembled sparse matrix.
+class LSCMOperator : public Eigen::EigenBase<LSCMOperator>
+{
+public:
+    typedef double Scalar;
+    typedef double RealScalar;
+    typedef int StorageIndex;
+
+    enum
+    {
+        ColsAtCompileTime = Eigen::Dynamic,
+        MaxColsAtCompileTime = Eigen::Dynamic,
+        IsRowMajor = false
+    };
+
+    // Column of a pinned vertex, which is moved to the right hand side
+    static const size_t FIXED;
+
+private:
+    struct Face
+    {
+        size_t columns[3];
+        double re[3];
+        double im[3];
+    };
+
+    std::vector<Face> _faces;
+    size_t _numColumns;
+
+public:
+    LSCMOperator();
+
+    void resize(size_t numFaces, size_t numColumns);
+
+    // columns holds the u column of each vertex, v is always u + 1
+    void setFace(size_t index, const size_t* columns, const double* re, const double* im);
+
+    Eigen::Index rows() const;
+    Eigen::Index cols() const;
+
+    size_t numFaces() const;
+
+    // y = A * x, with two rows per face
+    void apply(const MatrixXx1& x, MatrixXx1& y) const;
+
+    // x = Aᵀ * y
+    void applyTranspose(const MatrixXx1& y, MatrixXx1& x) const;
+
+    // y += alpha * AᵀA * x
+    template<typename Rhs, typename Dest>
+    void addNormal(const Rhs& x, Dest& y, double alpha) const;
+
+    void diagonal(MatrixXx1& d) const;
+
+    template<typename Rhs>
+    Eigen::Product<LSCMOperator, Rhs, Eigen::AliasFreeProduct> operator*(const Eigen::MatrixBase<Rhs>& x) const
+    {
+        return Eigen::Product<LSCMOperator, Rhs, Eigen::AliasFreeProduct>(*this, x.derived());
+    }
+};
+
+// Jacobi preconditioner for LSCMOperator, equivalent to the column scaling
+// LeastSquaresConjugateGradient applies to the assembled matrix.
+class LSCMPreconditioner
+{
+private:
+    MatrixXx1 _invDiagonal;
+
+public:
+    typedef double Scalar;
+    typedef MatrixXx1 Vector;
+
+    LSCMPreconditioner();
+
+    LSCMPreconditioner& analyzePattern(const LSCMOperator& op);
+    LSCMPreconditioner& factorize(const LSCMOperator& op);
+    LSCMPreconditioner& compute(const LSCMOperator& op);
+
+    MatrixXx1 solve(const MatrixXx1& b) const;
+
+    Eigen::ComputationInfo info() const;
+};
+
+template<typename Rhs, typename Dest>
+void LSCMOperator::addNormal(const Rhs& x, Dest& y, double alpha) const
+{
+    for (const auto& face : _faces)
+    {
+        auto real = 0.0;
+        auto imaginary = 0.0;
+
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto u = face.columns[i];
+
+            if (u == FIXED)
+            {
+                continue;
+            }
+
+            real += face.re[i] * x[u] + face.im[i] * x[u + 1];
+            imaginary += -face.im[i] * x[u] + face.re[i] * x[u + 1];
+        }
+
+        real *= alpha;
+        imaginary *= alpha;
+
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto u = face.columns[i];
+
+            if (u == FIXED)
+            {
+                continue;
+            }
+
+            y[u] += face.re[i] * real - face.im[i] * imaginary;
+            y[u + 1] += face.im[i] * real + face.re[i] * imaginary;
+        }
+    }
+}
+
+namespace Eigen
+{
+namespace internal
+{
+    template<typename Rhs>
+    struct generic_product_impl<LSCMOperator, Rhs, SparseShape, DenseShape, GemvProduct>
+    : generic_product_impl_base<LSCMOperator, Rhs, generic_product_impl<LSCMOperator, Rhs>>
+    {
+        typedef typename Product<LSCMOperator, Rhs>::Scalar Scalar;
+
+        template<typename Dest>
+        static void scaleAndAddTo(Dest& dst, const LSCMOperator& lhs, const Rhs& rhs, const Scalar& alpha)
+        {
+            lhs.addNormal(rhs, dst, alpha);
+        }
+    };
+}
+}
@@ -0,0 +1,548 @@
+//
+//  MultilevelSolver.cpp
+//  LSCM
+//
+//  Solves the normal equations of the LSCM system with conjugate gradients,
+//  preconditioned by a V-cycle over a ChartHierarchy. Every level is
+//  rediscretized from its own faces, weighted by area so coarse faces carry
+//  the energy of the fine faces they replace. Levels are smoothed with a few
+//  Gauss-Seidel sweeps and the coarsest level is factored directly.
+//
+
+#include "MultilevelSolver.h"
+
+#include <chrono>
+
+#include "Parameterizer.h"
+
+MultilevelSolver::MultilevelSolver(const std::vector<Mesh::Point>* points, const ChartHierarchy* hierarchy, const std::vector<Anchor>& anchors)
+: _points(points)
+, _hierarchy(hierarchy)
+, _anchors(anchors)
+, _smoothingIterations(8)
+, _tolerance(0.001)
+, _absoluteTolerance(0)
+, _threshold(0.0000001)
+, _mixedPrecision(false)
+, _maxIterations(0)
+, _timeBudget(0)
+, _iterations(0)
+, _error(0)
+, _converged(false)
+{
+}
+
+void MultilevelSolver::setSmoothing(size_t iterations, double tolerance)
+{
+    _smoothingIterations = std::max((size_t)1, iterations);
+    _tolerance = tolerance;
+}
+
+void MultilevelSolver::setAbsoluteTolerance(double tolerance)
+{
+    _absoluteTolerance = tolerance;
+}
+
+void MultilevelSolver::setThreshold(double threshold)
+{
+    _threshold = threshold;
+}
+
+void MultilevelSolver::setMixedPrecision(bool mixedPrecision)
+{
+    _mixedPrecision = mixedPrecision;
+}
+
+void MultilevelSolver::setBudget(double seconds, size_t maxIterations)
+{
+    _timeBudget = seconds;
+    _maxIterations = maxIterations;
+}
+
+size_t MultilevelSolver::iterations() const
+{
+    return _iterations;
+}
+
+double MultilevelSolver::error() const
+{
+    return _error;
+}
+
+bool MultilevelSolver::converged() const
+{
+    return _converged;
+}
+
+void MultilevelSolver::solve(MatrixXx1& uv)
+{
+    const auto& levels = _hierarchy->levels();
+    const auto numVertices = _hierarchy->numVertices();
+    const auto noColumn = std::numeric_limits<size_t>::max();
+
+    std::vector<bool> anchored(numVertices, false);
+
+    for (const auto& anchor : _anchors)
+    {
+        anchored[anchor.vertex] = true;
+    }
+
+    // Unknowns of each level are the vertices which survive coarsening
+    std::vector<bool> present(numVertices, false);
+
+    for (const auto& face : levels.front().faces)
+    {
+        for (const auto& vertex : face)
+        {
+            present[vertex] = true;
+        }
+    }
+
+    std::vector<std::vector<size_t>> columns(levels.size(), std::vector<size_t>(numVertices, noColumn));
+    std::vector<size_t> numColumns(levels.size(), 0);
+
+    for (auto i = 0; i < levels.size(); i++)
+    {
+        for (auto vertex = 0; vertex < numVertices; vertex++)
+        {
+            if (present[vertex] && !anchored[vertex])
+            {
+                columns[i][vertex] = numColumns[i];
+                numColumns[i] += 2;
+            }
+        }
+
+        for (const auto& collapse : levels[i].collapses)
+        {
+            present[collapse.vertex] = false;
+        }
+    }
+
+    _levels.clear();
+    _levels.resize(levels.size());
+
+    SparseMatrix A;
+    MatrixXx1 b;
+    MatrixXx1 rhs;
+
+    // Face rows are not area weighted, so the energy of the finest level
+    // scales with its local face area. Coarser faces are weighted by the
+    // area density of the finest faces around them to match it.
+    _density.assign(numVertices, 0.0);
+    std::vector<size_t> counts(numVertices, 0);
+
+    for (const auto& face : levels.front().faces)
+    {
+        const auto area = faceArea(face);
+
+        for (const auto& vertex : face)
+        {
+            _density[vertex] += area;
+            counts[vertex]++;
+        }
+    }
+
+    for (auto vertex = 0; vertex < numVertices; vertex++)
+    {
+        _density[vertex] /= std::max((size_t)1, counts[vertex]);
+    }
+
+    for (auto i = 0; i < levels.size(); i++)
+    {
+        auto& level = _levels[i];
+
+        assemble(levels[i].faces, columns[i], numColumns[i], i > 0, A, b);
+
+        level.N = A.transpose() * A;
+
+        if (i == 0)
+        {
+            rhs = A.transpose() * b;
+        }
+        else
+        {
+            buildProlongation(levels[i - 1], columns[i - 1], numColumns[i - 1], columns[i], numColumns[i], _levels[i - 1].P);
+        }
+    }
+
+    if (_mixedPrecision)
+    {
+        // Only the finest operator stays in double, for the outer residual
+        _floatLevels.clear();
+        _floatLevels.resize(_levels.size());
+
+        for (auto i = 0; i < _levels.size(); i++)
+        {
+            _floatLevels[i].N = _levels[i].N.cast<float>();
+            _floatLevels[i].P = _levels[i].P.cast<float>();
+
+            if (i > 0 && i + 1 < _levels.size())
+            {
+                _levels[i].N.resize(0, 0);
+            }
+
+            _levels[i].P.resize(0, 0);
+        }
+    }
+
+    _coarseSolver.compute(_levels.back().N);
+
+    // Conjugate gradients on the normal equations, which shares its stopping
+    // criterion with LSCG, or stops once vertices no longer move further than
+    // the UV tolerance relative to the chart size.
+    const auto n = numColumns.front();
+    const auto rhsNorm = std::max(DBL_MIN, rhs.norm());
+    const auto maxIterations = std::max((size_t)1, _maxIterations > 0 ? std::min(_maxIterations, n * 5) : n * 5);
+    const auto start = std::chrono::steady_clock::now();
+
+    MatrixXx1 x = MatrixXx1::Zero(n);
+    MatrixXx1 r = rhs;
+
+    MatrixXx1 z;
+    precondition(r, z);
+
+    MatrixXx1 p = z;
+    MatrixXx1 Np(n);
+    MatrixXx1 rPrevious;
+
+    auto rz = r.dot(z);
+    auto previousStep = DBL_MAX;
+
+    _iterations = 0;
+    _error = 0;
+
+    auto isWithinTolerance = false;
+
+    while (_iterations < maxIterations && r.norm() / rhsNorm > _threshold)
+    {
+        if (_timeBudget > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > _timeBudget)
+        {
+            break;
+        }
+
+        Np.noalias() = _levels.front().N * p;
+
+        const auto alpha = rz / p.dot(Np);
+
+        x += alpha * p;
+
+        if (_mixedPrecision)
+        {
+            rPrevious = r;
+        }
+
+        r -= alpha * Np;
+
+        _iterations++;
+
+        auto min = Eigen::Vector2d(DBL_MAX, DBL_MAX);
+        auto max = Eigen::Vector2d(-DBL_MAX, -DBL_MAX);
+
+        for (auto i = 0; i < n; i += 2)
+        {
+            const auto q = Eigen::Vector2d(x[i], x[i + 1]);
+
+            min = min.cwiseMin(q);
+            max = max.cwiseMax(q);
+        }
+
+        const auto tolerance = _absoluteTolerance > 0 ? _absoluteTolerance : _tolerance * (max - min).maxCoeff();
+        const auto step = std::abs(alpha) * p.cwiseAbs().maxCoeff();
+        const auto rate = step / previousStep;
+
+        _error = rate < 1 ? step * rate / (1 - rate) : step;
+
+        if (rate < 1 && step < tolerance && _error < tolerance)
+        {
+            isWithinTolerance = true;
+            break;
+        }
+
+        previousStep = step;
+
+        precondition(r, z);
+
+        const auto rzNext = r.dot(z);
+
+        // The float V-cycle is not exactly symmetric, so the mixed solve
+        // uses the flexible (Polak-Ribière) update to stay conjugate
+        const auto beta = _mixedPrecision ? (rzNext - rPrevious.dot(z)) / rz : rzNext / rz;
+
+        p = z + beta * p;
+        rz = rzNext;
+    }
+
+    // Also false when the residual is no longer finite
+    _converged = isWithinTolerance || r.norm() / rhsNorm <= _threshold;
+
+
+    uv.resize(numVertices * 2);
+    uv.setZero();
+
+    for (const auto& anchor : _anchors)
+    {
+        uv[anchor.vertex * 2] = anchor.u;
+        uv[anchor.vertex * 2 + 1] = anchor.v;
+    }
+
+    for (auto vertex = 0; vertex < numVertices; vertex++)
+    {
+        const auto column = columns.front()[vertex];
+
+        if (column != noColumn)
+        {
+            uv[vertex * 2] = x[column];
+            uv[vertex * 2 + 1] = x[column + 1];
+        }
+    }
+}
+
+double MultilevelSolver::faceArea(const ChartHierarchy::Face& face) const
+{
+    const auto& points = *_points;
+
+    return ((points[face[1]] - points[face[0]]) % (points[face[2]] - points[face[0]])).norm() * 0.5;
+}
+
+void MultilevelSolver::assemble(const ChartHierarchy::FaceArray& faces, const std::vector<size_t>& columns, size_t numColumns, bool weighted, SparseMatrix& A, MatrixXx1& b) const
+{
+    const auto& points = *_points;
+
+    std::vector<const Anchor*> anchors(points.size(), nullptr);
+
+    for (const auto& anchor : _anchors)
+    {
+        anchors[anchor.vertex] = &anchor;
+    }
+
+    TripletList a;
+    a.reserve(faces.size() * 12);
+
+    b.resize(faces.size() * 2);
+    b.setZero();
+
+    Mesh::Point v[3];
+    Mesh::Point pv[3];
+    double re[3];
+    double im[3];
+
+    for (auto f = 0; f < faces.size(); f++)
+    {
+        const auto& face = faces[f];
+        const auto realRow = f * 2;
+        const auto imRow = realRow + 1;
+
+        for (auto k = 0; k < 3; k++)
+        {
+            v[k] = points[face[k]];
+        }
+
+        Parameterizer::ProjectFace(v, pv);
+        Parameterizer::FaceCoefficients(pv, re, im);
+
+        if (weighted)
+        {
+            const auto density = (_density[face[0]] + _density[face[1]] + _density[face[2]]) / 3.0;
+            const auto weight = std::sqrt(density / std::max(DBL_MIN, faceArea(face)));
+
+            for (auto k = 0; k < 3; k++)
+            {
+                re[k] *= weight;
+                im[k] *= weight;
+            }
+        }
+
+        for (auto k = 0; k < 3; k++)
+        {
+            const auto* anchor = anchors[face[k]];
+
+            if (anchor)
+            {
+                b[realRow] -= re[k] * anchor->u + im[k] * anchor->v;
+                b[imRow] -= -im[k] * anchor->u + re[k] * anchor->v;
+            }
+            else
+            {
+                const auto column = columns[face[k]];
+
+                a.emplace_back(realRow, column, re[k]);
+                a.emplace_back(realRow, column + 1, im[k]);
+                a.emplace_back(imRow, column, -im[k]);
+                a.emplace_back(imRow, column + 1, re[k]);
+            }
+        }
+    }
+
+    A.resize(faces.size() * 2, numColumns);
+    A.setFromTriplets(a.begin(), a.end());
+    A.makeCompressed();
+}
+
+void MultilevelSolver::buildProlongation(const ChartHierarchy::Level& level, const std::vector<size_t>& fineColumns, size_t numFine, const std::vector<size_t>& coarseColumns, size_t numCoarse, SparseMatrix& P) const
+{
+    const auto& points = *_points;
+    const auto noColumn = std::numeric_limits<size_t>::max();
+
+    TripletList p;
+    p.reserve(numFine * 4);
+
+    for (auto vertex = 0; vertex < fineColumns.size(); vertex++)
+    {
+        const auto fine = fineColumns[vertex];
+        const auto coarse = coarseColumns[vertex];
+
+        if (fine != noColumn && coarse != noColumn)
+        {
+            p.emplace_back(fine, coarse, 1.0);
+            p.emplace_back(fine + 1, coarse + 1, 1.0);
+        }
+    }
+
+    // Removed vertices are interpolated with an affine fit over the tangent
+    // plane of their ring, which reproduces locally linear maps exactly.
+    for (const auto& collapse : level.collapses)
+    {
+        const auto& ring = collapse.ring;
+        const auto fine = fineColumns[collapse.vertex];
+
+        Eigen::Vector3d center = Eigen::Vector3d::Zero();
+
+        for (const auto& vertex : ring)
+        {
+            const auto& q = points[vertex];
+            center += Eigen::Vector3d(q[0], q[1], q[2]);
+        }
+
+        center /= (double)ring.size();
+
+        Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+
+        for (const auto& vertex : ring)
+        {
+            const auto& q = points[vertex];
+            const Eigen::Vector3d d = Eigen::Vector3d(q[0], q[1], q[2]) - center;
+
+            covariance += d * d.transpose();
+        }
+
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> frame(covariance);
+        const Eigen::Vector3d e0 = frame.eigenvectors().col(2);
+        const Eigen::Vector3d e1 = frame.eigenvectors().col(1);
+
+        MatrixX R(ring.size(), 3);
+
+        for (auto i = 0; i < ring.size(); i++)
+        {
+            const auto& q = points[ring[i]];
+            const Eigen::Vector3d d = Eigen::Vector3d(q[0], q[1], q[2]) - center;
+
+            R.row(i) << d.dot(e0), d.dot(e1), 1.0;
+        }
+
+        const auto& q = points[collapse.vertex];
+        const Eigen::Vector3d d = Eigen::Vector3d(q[0], q[1], q[2]) - center;
+        const Eigen::RowVector3d s(d.dot(e0), d.dot(e1), 1.0);
+
+        const MatrixX weights = s * R.colPivHouseholderQr().solve(MatrixX::Identity(ring.size(), ring.size()));
+
+        for (auto i = 0; i < ring.size(); i++)
+        {
+            const auto coarse = coarseColumns[ring[i]];
+
+            // Anchors are exact, so they carry no correction
+            if (coarse == noColumn)
+            {
+                continue;
+            }
+
+            p.emplace_back(fine, coarse, weights(0, i));
+            p.emplace_back(fine + 1, coarse + 1, weights(0, i));
+        }
+    }
+
+    P.resize(numFine, numCoarse);
+    P.setFromTriplets(p.begin(), p.end());
+    P.makeCompressed();
+}
+
+void MultilevelSolver::precondition(const MatrixXx1& r, MatrixXx1& z)
+{
+    if (_mixedPrecision)
+    {
+        _floatLevels.front().b = r.cast<float>();
+        vcycle(_floatLevels, _coarseSolver, 0);
+
+        z = _floatLevels.front().x.cast<double>();
+    }
+    else
+    {
+        _levels.front().b = r;
+        vcycle(_levels, _coarseSolver, 0);
+
+        z = _levels.front().x;
+    }
+}
+
+template<typename Scalar, typename Solver>
+void MultilevelSolver::vcycle(std::vector<Level<Scalar>>& levels, const Solver& coarseSolver, size_t index)
+{
+    auto& level = levels[index];
+
+    if (index + 1 == levels.size())
+    {
+        level.x = coarseSolver.solve(level.b.template cast<double>()).template cast<Scalar>();
+        return;
+    }
+
+    auto& coarse = levels[index + 1];
+
+    level.x.setZero(level.b.size());
+
+    for (auto i = 0; i < _smoothingIterations; i++)
+    {
+        Smooth(level, true);
+    }
+
+    coarse.b = level.P.transpose() * (level.b - level.N * level.x);
+
+    vcycle(levels, coarseSolver, index + 1);
+
+    level.x += level.P * coarse.x;
+
+    for (auto i = 0; i < _smoothingIterations; i++)
+    {
+        Smooth(level, false);
+    }
+}
+
+template<typename Scalar>
+void MultilevelSolver::Smooth(Level<Scalar>& level, bool forward)
+{
+    // Gauss-Seidel, alternating direction keeps the V-cycle symmetric
+    const auto n = (Eigen::Index)level.x.size();
+
+    for (auto k = 0; k < n; k++)
+    {
+        const auto i = forward ? k : n - 1 - k;
+
+        Scalar sum = level.b[i];
+        Scalar diagonal = 0;
+
+        for (typename Level<Scalar>::Matrix::InnerIterator it(level.N, i); it; ++it)
+        {
+            if (it.row() == i)
+            {
+                diagonal = it.value();
+            }
+            else
+            {
+                sum -= it.value() * level.x[it.row()];
+            }
+        }
+
+        if (diagonal > 0)
+        {
+            level.x[i] = sum / diagonal;
+        }
+    }
+}
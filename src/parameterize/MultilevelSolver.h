@@ -0,0 +1,103 @@
+
+#pragma once
+
+#include "../util/MatrixDef.h"
+
+#include "ChartHierarchy.h"
+
+class MultilevelSolver
+{
+public:
+    struct Anchor
+    {
+        size_t vertex;
+        double u;
+        double v;
+    };
+
+private:
+    template<typename Scalar>
+    struct Level
+    {
+        typedef Eigen::SparseMatrix<Scalar> Matrix;
+        typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+
+        // Normal equations of this level
+        Matrix N;
+
+        // Interpolates this level's unknowns from the next coarser level
+        Matrix P;
+
+        Vector x;
+        Vector b;
+    };
+
+    const std::vector<Mesh::Point>* _points;
+    const ChartHierarchy* _hierarchy;
+
+    std::vector<Anchor> _anchors;
+
+    std::vector<Level<double>> _levels;
+    std::vector<Level<float>> _floatLevels;
+    std::vector<double> _density;
+    Eigen::SimplicialLDLT<SparseMatrix> _coarseSolver;
+
+    size_t _smoothingIterations;
+    double _tolerance;
+    double _absoluteTolerance;
+    double _threshold;
+
+    bool _mixedPrecision;
+
+    size_t _maxIterations;
+    double _timeBudget;
+
+    size_t _iterations;
+    double _error;
+    bool _converged;
+
+public:
+    MultilevelSolver(const std::vector<Mesh::Point>* points, const ChartHierarchy* hierarchy, const std::vector<Anchor>& anchors);
+
+    void setSmoothing(size_t iterations, double tolerance);
+    // Overrides the tolerance relative to the chart size with one in UV units
+    void setAbsoluteTolerance(double tolerance);
+    void setThreshold(double threshold);
+
+    // Runs the V-cycle in single precision. The outer iterations keep the
+    // residual in double, so they refine the float preconditioner back to
+    // full accuracy.
+    void setMixedPrecision(bool mixedPrecision);
+
+    // Stops the outer iterations after this many seconds or iterations,
+    // 0 leaves either unbounded
+    void setBudget(double seconds, size_t maxIterations);
+
+    size_t iterations() const;
+
+    // Estimated distance the vertices could still move, in UV units
+    double error() const;
+
+    // Whether the last solve met its tolerance within the budget
+    bool converged() const;
+
+    // Solves the chart with conjugate gradients preconditioned by a V-cycle
+    // over the hierarchy. uv holds interleaved (u, v) pairs for every vertex
+    // of the chart.
+    void solve(MatrixXx1& uv);
+
+private:
+    double faceArea(const ChartHierarchy::Face& face) const;
+
+    void assemble(const ChartHierarchy::FaceArray& faces, const std::vector<size_t>& columns, size_t numColumns, bool weighted, SparseMatrix& A, MatrixXx1& b) const;
+
+    void buildProlongation(const ChartHierarchy::Level& level, const std::vector<size_t>& fineColumns, size_t numFine, const std::vector<size_t>& coarseColumns, size_t numCoarse, SparseMatrix& P) const;
+
+    void precondition(const MatrixXx1& r, MatrixXx1& z);
+
+    template<typename Scalar, typename Solver>
+    void vcycle(std::vector<Level<Scalar>>& levels, const Solver& coarseSolver, size_t index);
+
+    template<typename Scalar>
+    static void Smooth(Level<Scalar>& level, bool forward);
+};
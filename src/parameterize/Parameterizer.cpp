@@ -12,72 +12,1118 @@
 
 #include "Parameterizer.h"
 
+#include <algorithm>
+#include <cassert>
+#include <complex>
+#include <cstring>
 #include <iostream>
+#include <numeric>
+
+#include "../util/GraphOrdering.h"
+#include "../util/MeshUtil.h"
+
+#include "LSCMOperator.h"
+#include "MultilevelSolver.h"
+#include "SpectralSolver.h"
 
 const float MIN_DEFAULT = FLT_MAX;
 const float MAX_DEFAULT = -FLT_MAX;
 const float THRESHOLD = 0.0000001f;
+const size_t MULTILEVEL_COARSE_FACES = 1000;
+
+// Iterations timed before a solve with a time budget continues
+const size_t BUDGET_PROBE_ITERATIONS = 50;
+
+// Charts up to this many vertices are solved densely, without touching the heap
+const int SMALL_CHART_VERTICES = 50;
+
+typedef std::complex<double> Complex;
+typedef Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic, 0, SMALL_CHART_VERTICES, SMALL_CHART_VERTICES> SmallMatrix;
+typedef Eigen::Matrix<Complex, Eigen::Dynamic, 1, 0, SMALL_CHART_VERTICES, 1> SmallVector;
+
+namespace
+{
+    // Whether the rows of every column are in order, as Eigen expects
+    bool SortedColumns(const SparseMatrix& A)
+    {
+        const auto* outer = A.outerIndexPtr();
+        const auto* inner = A.innerIndexPtr();
+
+        for (auto j = 0; j < A.cols(); j++)
+        {
+            if (!std::is_sorted(inner + outer[j], inner + outer[j + 1]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+Parameterizer::Parameterizer(Mesh* mesh, const std::vector<Chart>* charts)
+: _mesh(mesh)
+, _charts(charts)
+, _matrixFree(false)
+, _reorder(true)
+, _topologyCache(nullptr)
+, _resultCache(nullptr)
+, _texelResolution(0)
+, _texelTolerance(0.1f)
+, _texelSize(0)
+, _multilevelFaces(0)
+, _smoothingIterations(1)
+, _uvTolerance(0.001f)
+, _mixedPrecision(false)
+, _timeBudget(0)
+, _maxIterations(0)
+, _engine(Engine::LSCM)
+{
+    _solver.setTolerance(THRESHOLD);
+}
+
+void Parameterizer::setMatrixFree(bool matrixFree)
+{
+    _matrixFree = matrixFree;
+}
+
+void Parameterizer::setReordering(bool reorder)
+{
+    _reorder = reorder;
+}
+
+void Parameterizer::setTopologyCache(TopologyCache* cache)
+{
+    _topologyCache = cache;
+}
+
+void Parameterizer::setResultCache(ResultCache* cache)
+{
+    _resultCache = cache;
+}
+
+void Parameterizer::setTexelTolerance(size_t resolution, float texels)
+{
+    _texelResolution = resolution;
+    _texelTolerance = texels;
+}
+
+void Parameterizer::setMultilevel(size_t minFaces, size_t smoothingIterations, float uvTolerance)
+{
+    _multilevelFaces = minFaces;
+    _smoothingIterations = smoothingIterations;
+    _uvTolerance = uvTolerance;
+}
+
+void Parameterizer::setMixedPrecision(bool mixedPrecision)
+{
+    _mixedPrecision = mixedPrecision;
+}
+
+void Parameterizer::setBudget(double seconds, size_t maxIterations)
+{
+    _timeBudget = seconds;
+    _maxIterations = maxIterations;
+}
+
+void Parameterizer::setEngine(Engine engine)
+{
+    _engine = engine;
+}
+
+void Parameterizer::setEngine(size_t chartId, Engine engine)
+{
+    _chartEngines[chartId] = engine;
+}
+
+const std::vector<SolveReport>& Parameterizer::reports() const
+{
+    return _reports;
+}
+
+void Parameterizer::build()
+{
+    std::cout << "Parameterizing..." << std::endl;
+
+    _frames.build(_mesh);
+
+    _texelSize = 0;
+
+    if (_texelResolution > 0)
+    {
+        // Charts are packed by area, so a texel covers about this much of the surface
+        auto area = 0.0;
+
+        for (const auto& chart : *_charts)
+        {
+            for (const auto& face : chart.faces())
+            {
+                area += _frames.area(face);
+            }
+        }
+
+        _texelSize = std::sqrt(area) / _texelResolution;
+    }
+
+    _reports.clear();
+
+    for (const auto& chart : *_charts)
+    {
+        build(chart);
+    }
+
+    const auto fallbacks = std::count_if(_reports.begin(), _reports.end(), [](const auto& report) { return report.isFallback(); });
+
+    if (fallbacks > 0)
+    {
+        std::cout << "Fallbacks: " << fallbacks << std::endl;
+    }
+
+    if (_topologyCache && _topologyCache->lookups() > 0)
+    {
+        std::cout << "Topology cache: " << _topologyCache->hits() << "/" << _topologyCache->lookups() << " hits ("
+            << 100.0 * _topologyCache->hits() / _topologyCache->lookups() << "%)" << std::endl;
+    }
+
+    if (_resultCache && _resultCache->lookups() > 0)
+    {
+        std::cout << "Result cache: " << _resultCache->hits() << "/" << _resultCache->lookups() << " hits ("
+            << 100.0 * _resultCache->hits() / _resultCache->lookups() << "%)" << std::endl;
+    }
+}
+
+const FaceFrames& Parameterizer::faceFrames() const
+{
+    return _frames;
+}
+
+void Parameterizer::build(const Chart& chart)
+{
+    std::cout << "\tChart: " << chart.id() << std::endl;
+
+    const auto numRows = chart.faces().size() * 2;
+
+    std::cout << "\tSize: " << numRows << std::endl;
+
+    _reports.push_back({chart.id(), {}});
+
+    _chartStart = Clock::now();
+    _attemptStart = _chartStart;
+
+    IntrinsicKey key;
+    const auto settings = _resultCache ? solveSettings(chart) : 0;
+
+    if (_resultCache)
+    {
+        key = IntrinsicKey::Build(_mesh, chart.faces(), chart.vertices());
+
+        if (_resultCache->find(key, settings, _uvs))
+        {
+            record(SolveMethod::Cached, 0, 0, true);
+            storeUVs(chart, _uvs.data());
+            return;
+        }
+    }
+
+    solve(chart);
+
+    // Planar projections are a last resort, not worth reusing
+    if (_resultCache && isConverged() && _reports.back().attempts.back().method != SolveMethod::Planar)
+    {
+        const auto& vertices = chart.vertices();
+        _uvs.resize(vertices.size());
+
+        for (auto i = 0; i < vertices.size(); i++)
+        {
+            _uvs[i] = _mesh->property(chart.texCoords(), vertices[i]);
+        }
+
+        _resultCache->store(key, settings, _uvs);
+    }
+}
+
+void Parameterizer::solve(const Chart& chart)
+{
+    setAnchors(chart);
+
+    if (engine(chart) == Engine::Spectral && buildSpectral(chart))
+    {
+        return;
+    }
+
+    if (buildSmall(chart))
+    {
+        return;
+    }
+
+    const auto isMultilevel = _multilevelFaces > 0 && chart.faces().size() >= _multilevelFaces;
+    const auto isCached = _topologyCache && !isMultilevel && !_matrixFree;
+    const auto hash = isCached ? MeshUtil::TopologyHash(_mesh, chart.faces()) : 0;
+
+    if (isCached && buildCached(chart, hash))
+    {
+        return;
+    }
+
+    buildMaps(chart);
+
+    if (isMultilevel)
+    {
+        buildMultilevel(chart);
+    }
+    else if (_matrixFree)
+    {
+        buildMatrixFree(chart);
+    }
+    else
+    {
+        buildPattern(chart);
+        setCoefficients(chart, _rows, _slots, _A);
+
+        _x = MatrixXx1::Zero(_A.cols());
+        solveLeastSquares(_A, _x);
+
+        if (isCached && isConverged())
+        {
+            cacheTopology(chart, hash);
+        }
+    }
+
+    if (!isConverged())
+    {
+        fallback(chart);
+    }
+
+    storeUVs(chart);
+}
+
+Parameterizer::Engine Parameterizer::engine(const Chart& chart) const
+{
+    return _chartEngines.count(chart.id()) > 0 ? _chartEngines.at(chart.id()) : _engine;
+}
+
+// Everything besides the chart's geometry that its UVs depend on: the engine
+// and the settings of every solver the chart may go through, down to the
+// fallbacks its bounds lead to
+uint64_t Parameterizer::solveSettings(const Chart& chart) const
+{
+    // FNV-1a, as for MeshUtil::TopologyHash
+    uint64_t hash = 14695981039346656037ull;
+
+    const auto combine = [&hash](uint64_t value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    const auto bits = [](double value)
+    {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        return bits;
+    };
+
+    const auto isMultilevel = _multilevelFaces > 0 && chart.faces().size() >= _multilevelFaces;
+
+    combine((uint64_t)engine(chart));
+    combine(_matrixFree);
+    combine(isMultilevel);
+
+    if (isMultilevel)
+    {
+        combine(_smoothingIterations);
+        combine(bits(_uvTolerance));
+        combine(bits(_texelTolerance * _texelSize));
+        combine(_mixedPrecision);
+    }
+
+    combine(bits(_timeBudget));
+    combine(_maxIterations);
+
+    return hash;
+}
+
+bool Parameterizer::buildCached(const Chart& chart, size_t hash)
+{
+    auto* entry = _topologyCache->find(hash, topology(chart));
+
+    if (!entry)
+    {
+        return false;
+    }
+
+    // Keep the cached anchors so the columns stay valid, and frames of
+    // the same chart stay pinned at the same vertices
+    Mesh::Point a[2];
+    findAxii(chart, a);
+
+    _anchors.resize(entry->anchors.size());
+
+    for (auto i = 0; i < _anchors.size(); i++)
+    {
+        const auto& p = _mesh->point(entry->anchors[i]);
+
+        _anchors[i] = {Mesh::Point(p | a[0], p | a[1], 0), entry->anchors[i]};
+    }
+
+    setCoefficients(chart, entry->rows, entry->slots, entry->A);
+
+    solveLeastSquares(entry->A, entry->x);
+
+    if (!isConverged())
+    {
+        // Start the next frame from scratch rather than from this solution
+        entry->x.setZero();
+
+        buildMaps(chart);
+        fallback(chart);
+
+        storeUVs(chart);
+        return true;
+    }
+
+    const auto& vertices = chart.vertices();
+    _uvs.resize(vertices.size());
+
+    for (auto i = 0; i < vertices.size(); i++)
+    {
+        const auto column = entry->columns[i];
+
+        if (column == TopologyCache::FIXED)
+        {
+            const auto& anchor = getAnchor(vertices[i]);
+            _uvs[i] = Mesh::TexCoord2D(anchor.uv[0], anchor.uv[1]);
+        }
+        else
+        {
+            _uvs[i] = Mesh::TexCoord2D(entry->x[column], entry->x[column + 1]);
+        }
+    }
+
+    storeUVs(chart, _uvs.data());
+
+    return true;
+}
+
+void Parameterizer::cacheTopology(const Chart& chart, size_t hash)
+{
+    TopologyCache::Entry entry;
+
+    entry.topology = topology(chart);
+
+    for (const auto& anchor : _anchors)
+    {
+        entry.anchors.push_back(anchor.h);
+    }
+
+    entry.rows = _rows;
+    entry.slots = _slots;
+
+    for (const auto& vertex : chart.vertices())
+    {
+        entry.columns.push_back(isAnchor(vertex) ? TopologyCache::FIXED : _vmap.at(vertex));
+    }
+
+    entry.A = _A;
+    entry.x = _x;
+
+    _topologyCache->store(hash, entry);
+}
+
+std::vector<int> Parameterizer::topology(const Chart& chart) const
+{
+    const auto& faces = chart.faces();
+    const auto& vertices = chart.vertices();
+
+    std::vector<int> topology;
+    topology.reserve(1 + faces.size() * 4 + vertices.size());
+
+    topology.push_back((int)faces.size());
+
+    for (const auto& face : faces)
+    {
+        topology.push_back(face.idx());
+
+        auto fv_it = _mesh->cfv_begin(face), fv_end = _mesh->cfv_end(face);
+        for (; fv_it != fv_end; fv_it++)
+        {
+            topology.push_back(fv_it->idx());
+        }
+    }
+
+    for (const auto& vertex : vertices)
+    {
+        topology.push_back(vertex.idx());
+    }
+
+    return topology;
+}
+
+// Runs an iterative solver from x within a time budget, 0 being unbounded.
+// A first short run measures the cost of an iteration, then the rest of
+// the budget is spent continuing from where it stopped.
+template<typename Solver, typename Rhs>
+static size_t SolveWithBudget(Solver& solver, const Rhs& b, MatrixXx1& x, size_t maxIterations, double seconds)
+{
+    if (seconds <= 0)
+    {
+        solver.setMaxIterations(maxIterations);
+        x = solver.solveWithGuess(b, x);
+
+        return solver.iterations();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    solver.setMaxIterations(std::min(maxIterations, BUDGET_PROBE_ITERATIONS));
+    x = solver.solveWithGuess(b, x);
+
+    size_t iterations = solver.iterations();
+
+    if (solver.info() == Eigen::Success || iterations >= maxIterations)
+    {
+        return iterations;
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto perIteration = elapsed / std::max((size_t)1, iterations);
+    const auto remaining = (seconds - elapsed) / perIteration;
+
+    if (remaining < 1)
+    {
+        return iterations;
+    }
+
+    solver.setMaxIterations(std::min(maxIterations - iterations, (size_t)remaining));
+    x = solver.solveWithGuess(b, x);
+
+    return iterations + solver.iterations();
+}
+
+// Solves H z = b in place for a small Hermitian positive definite system,
+// factoring H into UᴴU in its upper triangle. Eigen's blocked LLT has too
+// much per-call overhead at these sizes.
+static bool CholeskySolve(SmallMatrix& H, SmallVector& b)
+{
+    const auto n = H.rows();
+
+    for (auto j = 0; j < n; j++)
+    {
+        auto* cj = H.col(j).data();
+
+        auto d = cj[j].real();
+
+        for (auto k = 0; k < j; k++)
+        {
+            d -= std::norm(cj[k]);
+        }
+
+        if (!(d > 0))
+        {
+            return false;
+        }
+
+        d = std::sqrt(d);
+        cj[j] = d;
+
+        for (auto i = j + 1; i < n; i++)
+        {
+            auto* ci = H.col(i).data();
+
+            auto value = ci[j];
+
+            for (auto k = 0; k < j; k++)
+            {
+                value -= std::conj(cj[k]) * ci[k];
+            }
+
+            ci[j] = value / d;
+        }
+    }
+
+    for (auto i = 0; i < n; i++)
+    {
+        const auto* ci = H.col(i).data();
+
+        for (auto k = 0; k < i; k++)
+        {
+            b[i] -= std::conj(ci[k]) * b[k];
+        }
+
+        b[i] /= ci[i].real();
+    }
+
+    for (auto i = n - 1; i >= 0; i--)
+    {
+        const auto* ci = H.col(i).data();
+
+        b[i] /= ci[i].real();
+
+        for (auto k = 0; k < i; k++)
+        {
+            b[k] -= ci[k] * b[i];
+        }
+    }
+
+    return true;
+}
+
+// The normal equations of a chart are a complex system: each face's
+// residual is Σ conj(c_k) z_k with c = re + i im and z = u + i v, so the
+// (u, v) blocks of AᵀA form the Hermitian matrix H = Σ c cᴴ. Solving it
+// instead of the real system halves the size of the factorization.
+bool Parameterizer::buildSmall(const Chart& chart)
+{
+    const auto& vertices = chart.vertices();
+    const auto numVertices = vertices.size();
+
+    if (numVertices > SMALL_CHART_VERTICES)
+    {
+        return false;
+    }
+
+    // Unknowns follow the chart's vertex order, anchors go to the right hand side
+    const size_t NONE = (size_t)-1;
+
+    size_t columns[SMALL_CHART_VERTICES];
+    Complex fixed[SMALL_CHART_VERTICES];
+    auto numColumns = 0;
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        const auto anchor = findAnchor(vertices[i]);
+
+        if (anchor != _anchors.end())
+        {
+            columns[i] = NONE;
+            fixed[i] = Complex(anchor->uv[0], anchor->uv[1]);
+        }
+        else
+        {
+            columns[i] = numColumns++;
+        }
+    }
+
+    SmallMatrix H = SmallMatrix::Zero(numColumns, numColumns);
+    SmallVector b = SmallVector::Zero(numColumns);
+
+    Mesh::Point pv[3];
+    size_t indices[3];
+    Complex c[3];
+    double re[3];
+    double im[3];
+
+    for (const auto& face : chart.faces())
+    {
+        auto i = 0;
+        auto fv_it = _mesh->fv_begin(face), fv_end = _mesh->fv_end(face);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            indices[i] = std::distance(vertices.begin(), std::find(vertices.begin(), vertices.end(), *fv_it));
+        }
+
+        _frames.project(face, pv);
+        FaceCoefficients(pv, re, im);
+
+        auto residual = Complex();
+
+        for (auto j = 0; j < 3; j++)
+        {
+            c[j] = Complex(re[j], im[j]);
+
+            if (columns[indices[j]] == NONE)
+            {
+                residual += std::conj(c[j]) * fixed[indices[j]];
+            }
+        }
+
+        for (auto j = 0; j < 3; j++)
+        {
+            const auto cj = columns[indices[j]];
+
+            if (cj == NONE)
+            {
+                continue;
+            }
+
+            for (auto k = 0; k < 3; k++)
+            {
+                const auto ck = columns[indices[k]];
+
+                if (ck != NONE)
+                {
+                    H(cj, ck) += c[j] * std::conj(c[k]);
+                }
+            }
+
+            b[cj] -= c[j] * residual;
+        }
+    }
+
+    if (!CholeskySolve(H, b))
+    {
+        record(SolveMethod::Small, 0, 0, false);
+        return false;
+    }
+
+    record(SolveMethod::Small, 0, 0, true);
+
+    Mesh::TexCoord2D uvs[SMALL_CHART_VERTICES];
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        const auto z = columns[i] == NONE ? fixed[i] : b[columns[i]];
+
+        uvs[i] = Mesh::TexCoord2D(z.real(), z.imag());
+    }
+
+    storeUVs(chart, uvs);
+
+    return true;
+}
+
+void Parameterizer::buildMatrixFree(const Chart& chart)
+{
+    LSCMOperator op;
+    op.resize(_fmap.size(), _vmap.size() * 2);
+
+    _e.resize(_fmap.size() * 2);
+    _e.setZero();
+
+    Mesh::Point pv[3];
+    VertexId vIds[3];
+    size_t columns[3];
+    double re[3];
+    double im[3];
+
+    for (const auto& face : chart.faces())
+    {
+        const auto realRow = _fmap[face];
+        const auto imRow = realRow + 1;
+
+        gatherAndProjectFace(face, pv, vIds);
+
+        FaceCoefficients(pv, re, im);
+
+        for (auto i = 0; i < 3; i++)
+        {
+            if (!isAnchor(vIds[i].h))
+            {
+                columns[i] = vIds[i].u;
+                continue;
+            }
+
+            // Pinned vertices move to the right hand side
+            const auto& anchor = getAnchor(vIds[i].h);
+
+            columns[i] = LSCMOperator::FIXED;
+
+            _e[realRow] -= re[i] * anchor.uv[0] + im[i] * anchor.uv[1];
+            _e[imRow] -= -im[i] * anchor.uv[0] + re[i] * anchor.uv[1];
+        }
+
+        op.setFace(realRow / 2, columns, re, im);
+    }
+
+    MatrixXx1 b;
+    op.applyTranspose(_e, b);
+
+    Eigen::ConjugateGradient<LSCMOperator, Eigen::Lower | Eigen::Upper, LSCMPreconditioner> solver;
+    solver.setTolerance(THRESHOLD);
+    solver.compute(op);
+
+    _x = MatrixXx1::Zero(op.cols());
+
+    if (!b.allFinite())
+    {
+        record(SolveMethod::MatrixFree, 0, 0, false);
+        return;
+    }
+
+    const auto iterations = SolveWithBudget(solver, b, _x, maxIterations(op.cols()), remainingBudget());
+
+    std::cout << "\tIterations: " << iterations << std::endl;
+    std::cout << "\tError: " << solver.error() << std::endl;
+
+    record(SolveMethod::MatrixFree, iterations, solver.error(), solver.info() == Eigen::Success && _x.allFinite());
+}
+
+void Parameterizer::buildMultilevel(const Chart& chart)
+{
+    VertexMap local;
+    std::vector<Mesh::Point> points;
+    points.reserve(chart.vertices().size());
+
+    for (const auto& vertex : chart.vertices())
+    {
+        local[vertex] = points.size();
+        points.push_back(_mesh->point(vertex));
+    }
+
+    ChartHierarchy::FaceArray faces;
+    faces.reserve(chart.faces().size());
+
+    for (const auto& face : chart.faces())
+    {
+        ChartHierarchy::Face indices;
+
+        auto i = 0;
+        auto fv_it = _mesh->fv_begin(face), fv_end = _mesh->fv_end(face);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            indices[i] = local.at(*fv_it);
+        }
+
+        faces.push_back(indices);
+    }
+
+    std::vector<MultilevelSolver::Anchor> anchors;
+    std::vector<size_t> pinned;
+
+    for (const auto& anchor : _anchors)
+    {
+        const auto vertex = local.at(anchor.h);
+
+        anchors.push_back({vertex, anchor.uv[0], anchor.uv[1]});
+        pinned.push_back(vertex);
+    }
+
+    ChartHierarchy hierarchy(&points, faces, pinned);
+    hierarchy.build(MULTILEVEL_COARSE_FACES);
+
+    MultilevelSolver solver(&points, &hierarchy, anchors);
+    solver.setSmoothing(_smoothingIterations, _uvTolerance);
+
+    if (_texelSize > 0)
+    {
+        solver.setAbsoluteTolerance(_texelTolerance * _texelSize);
+    }
+
+    solver.setThreshold(THRESHOLD);
+    solver.setMixedPrecision(_mixedPrecision);
+    solver.setBudget(remainingBudget(), _maxIterations);
+
+    MatrixXx1 uv;
+    solver.solve(uv);
+
+    std::cout << "\tLevels: " << hierarchy.levels().size() << std::endl;
+    std::cout << "\tIterations: " << solver.iterations() << std::endl;
+    std::cout << "\tError: " << solver.error();
+
+    if (_texelSize > 0)
+    {
+        std::cout << " (" << solver.error() / _texelSize << " texels)";
+    }
+
+    std::cout << std::endl;
+
+    record(SolveMethod::Multilevel, solver.iterations(), solver.error(), solver.converged());
+
+    _x.resize(_vmap.size() * 2);
+
+    for (const auto& entry : _vmap)
+    {
+        const auto vertex = local.at(entry.first);
+
+        _x[entry.second] = uv[vertex * 2];
+        _x[entry.second + 1] = uv[vertex * 2 + 1];
+    }
+}
+
+// Assembles the conformal energy of the whole chart, without anchors, with
+// every face weighted by its area so the energy does not depend on the
+// triangulation, and the mass of its boundary, lumped onto its vertices.
+// Unknowns follow the chart's vertex order.
+bool Parameterizer::buildSpectral(const Chart& chart)
+{
+    const auto& faces = chart.faces();
+    const auto& vertices = chart.vertices();
+    const auto numColumns = vertices.size() * 2;
+
+    VertexMap local;
+
+    for (const auto& vertex : vertices)
+    {
+        const auto id = local.size() * 2;
+        local[vertex] = id;
+    }
+
+    TripletList triplets;
+    triplets.reserve(faces.size() * 36);
+
+    Mesh::Point pv[3];
+    double re[3];
+    double im[3];
+    size_t columns[3];
+
+    for (const auto& face : faces)
+    {
+        const auto area = _frames.area(face);
+
+        if (!(area > 0))
+        {
+            continue;
+        }
+
+        auto i = 0;
+        auto fv_it = _mesh->fv_begin(face), fv_end = _mesh->fv_end(face);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            columns[i] = local.at(*fv_it);
+        }
+
+        _frames.project(face, pv);
+        FaceCoefficients(pv, re, im);
+
+        const auto w = 1.0 / (2.0 * area);
+
+        for (i = 0; i < 3; i++)
+        {
+            for (auto j = 0; j < 3; j++)
+            {
+                const auto same = w * (re[i] * re[j] + im[i] * im[j]);
+                const auto cross = w * (re[i] * im[j] - im[i] * re[j]);
+
+                triplets.emplace_back(columns[i], columns[j], same);
+                triplets.emplace_back(columns[i], columns[j] + 1, cross);
+                triplets.emplace_back(columns[i] + 1, columns[j], -cross);
+                triplets.emplace_back(columns[i] + 1, columns[j] + 1, same);
+            }
+        }
+    }
 
-Parameterizer::Parameterizer(Mesh* mesh, const std::vector<Chart>* charts)
-: _mesh(mesh)
-, _charts(charts)
+    SparseMatrix L(numColumns, numColumns);
+    L.setFromTriplets(triplets.begin(), triplets.end());
+
+    MatrixXx1 B = MatrixXx1::Zero(numColumns);
+
+    for (const auto& edge : chart.perimeterEdges())
+    {
+        const auto halfedge = _mesh->halfedge_handle(edge, 0);
+        const auto from = local.find(_mesh->from_vertex_handle(halfedge));
+        const auto to = local.find(_mesh->to_vertex_handle(halfedge));
+
+        if (from == local.end() || to == local.end())
+        {
+            continue;
+        }
+
+        const auto mass = (_mesh->point(to->first) - _mesh->point(from->first)).length() * 0.5;
+
+        B.segment<2>(from->second).array() += mass;
+        B.segment<2>(to->second).array() += mass;
+    }
+
+    // Starts from the planar projection, which the conformal map is close to
+    Mesh::Point a[2];
+    findAxii(chart, a);
+
+    MatrixXx1 x(numColumns);
+
+    for (const auto& entry : local)
+    {
+        const auto& p = _mesh->point(entry.first);
+
+        x[entry.second] = p | a[0];
+        x[entry.second + 1] = p | a[1];
+    }
+
+    SpectralSolver solver(&L, &B);
+    solver.setBudget(remainingBudget(), _maxIterations);
+
+    solver.solve(x);
+
+    std::cout << "\tIterations: " << solver.iterations() << std::endl;
+    std::cout << "\tError: " << solver.error() << std::endl;
+
+    record(SolveMethod::Spectral, solver.iterations(), solver.error(), solver.converged());
+
+    if (!solver.converged())
+    {
+        std::cout << "\tFallback: LSCM" << std::endl;
+        return false;
+    }
+
+    _uvs.resize(vertices.size());
+
+    for (auto i = 0; i < vertices.size(); i++)
+    {
+        _uvs[i] = Mesh::TexCoord2D(x[i * 2], x[i * 2 + 1]);
+    }
+
+    storeUVs(chart, _uvs.data());
+
+    return true;
+}
+
+void Parameterizer::solveLeastSquares(const SparseMatrix& A, MatrixXx1& x)
 {
-    _solver.setTolerance(THRESHOLD);
+    // Degenerate faces give coefficients no iteration recovers from
+    if (!_e.allFinite() || !Eigen::Map<const MatrixXx1>(A.valuePtr(), A.nonZeros()).allFinite())
+    {
+        record(SolveMethod::Iterative, 0, 0, false);
+        return;
+    }
+
+    _solver.compute(A);
+
+    const auto iterations = SolveWithBudget(_solver, _e, x, maxIterations(A.cols()), remainingBudget());
+
+    std::cout << "\tIterations: " << iterations << std::endl;
+    std::cout << "\tError: " << _solver.error() << std::endl;
+
+    record(SolveMethod::Iterative, iterations, _solver.error(), _solver.info() == Eigen::Success && x.allFinite());
 }
 
-void Parameterizer::build()
+void Parameterizer::fallback(const Chart& chart)
 {
-    std::cout << "Parameterizing..." << std::endl;
+    std::cout << "\tFallback: " << SolveReport::MethodName(SolveMethod::Direct) << std::endl;
 
-    for (const auto& chart : *_charts)
+    if (solveDirect(chart, SolveMethod::Direct))
     {
-        build(chart);
+        return;
     }
+
+    std::cout << "\tFallback: " << SolveReport::MethodName(SolveMethod::Reanchored) << std::endl;
+
+    reanchor(chart);
+    buildMaps(chart);
+
+    if (solveDirect(chart, SolveMethod::Reanchored))
+    {
+        return;
+    }
+
+    std::cout << "\tFallback: " << SolveReport::MethodName(SolveMethod::Planar) << std::endl;
+
+    solvePlanar(chart);
 }
 
-void Parameterizer::build(const Chart& chart)
+bool Parameterizer::solveDirect(const Chart& chart, SolveMethod method)
 {
-    std::cout << "\tChart: " << chart.id() << std::endl;
+    buildPattern(chart);
+    setCoefficients(chart, _rows, _slots, _A);
 
-    const auto numRows = chart.faces().size() * 2;
+    const SparseMatrix N = _A.transpose() * _A;
+    const MatrixXx1 b = _A.transpose() * _e;
 
-    std::cout << "\tSize: " << numRows << std::endl;
+    Eigen::SimplicialLDLT<SparseMatrix> solver(N);
 
-    setAnchors(chart);
+    auto error = 0.0;
+    auto converged = solver.info() == Eigen::Success;
 
-    buildMaps(chart);
+    if (converged)
+    {
+        _x = solver.solve(b);
+
+        error = (N * _x - b).norm() / std::max(DBL_MIN, b.norm());
+        converged = _x.allFinite() && error < THRESHOLD;
+    }
 
-    _a.clear();
-    _A.resize(numRows, _vmap.size() * 2);
-    _A.setZero();
+    std::cout << "\tError: " << error << std::endl;
 
-    _fa.clear();
-    _fA.resize(numRows, _amap.size() * 2);
-    _fA.setZero();
+    record(method, 0, error, converged);
 
-    _fx.resize(_fA.cols());
-    _fx.setZero();
+    return converged;
+}
 
-    _e.resize(_fA.rows());
-    _e.setZero();
+// Projects the chart onto the plane of its two longest extents, which
+// always gives UVs but not conformal ones
+void Parameterizer::solvePlanar(const Chart& chart)
+{
+    Mesh::Point a[2];
+    findAxii(chart, a);
+
+    _x.resize(_vmap.size() * 2);
+
+    for (const auto& entry : _vmap)
+    {
+        const auto& p = _mesh->point(entry.first);
 
-    setCoefficients(chart);
+        _x[entry.second] = p | a[0];
+        _x[entry.second + 1] = p | a[1];
+    }
 
-    _fA.setFromTriplets(_fa.begin(), _fa.end());
-    _fA.makeCompressed();
+    for (auto& anchor : _anchors)
+    {
+        const auto& p = _mesh->point(anchor.h);
 
-    _A.setFromTriplets(_a.begin(), _a.end());
-    _A.makeCompressed();
+        anchor.uv = Mesh::Point(p | a[0], p | a[1], 0);
+    }
 
-    _e = _fA * _fx;
-    _e = _e * -1;
+    record(SolveMethod::Planar, 0, 0, true);
+}
 
-    _solver.setMaxIterations(_A.cols() * 5);
-    _solver.compute(_A);
+// Pins the two vertices furthest apart, instead of the extremes along the
+// chart's longest extent, which can coincide or sit too close on
+// degenerate charts
+void Parameterizer::reanchor(const Chart& chart)
+{
+    const auto& vertices = chart.vertices();
 
-    _x = _solver.solve(_e);
+    const auto furthest = [&](const Mesh::Point& from)
+    {
+        auto vertex = vertices.front();
+        auto maxDistance = -1.0f;
 
-    storeUVs(chart);
+        for (const auto& v : vertices)
+        {
+            const auto distance = (_mesh->point(v) - from).sqrnorm();
+
+            if (distance > maxDistance)
+            {
+                vertex = v;
+                maxDistance = distance;
+            }
+        }
+
+        return vertex;
+    };
+
+    const auto first = furthest(_mesh->point(vertices.front()));
+    const auto second = furthest(_mesh->point(first));
+
+    const auto distance = (_mesh->point(second) - _mesh->point(first)).length();
+
+    _anchors = {{Mesh::Point(0, 0, 0), first}, {Mesh::Point(distance, 0, 0), second}};
+}
+
+void Parameterizer::record(SolveMethod method, size_t iterations, double error, bool converged)
+{
+    const auto now = Clock::now();
+    const auto seconds = std::chrono::duration<double>(now - _attemptStart).count();
+
+    _reports.back().attempts.push_back({method, iterations, error, seconds, converged});
+
+    _attemptStart = now;
+}
+
+bool Parameterizer::isConverged() const
+{
+    const auto& attempts = _reports.back().attempts;
+
+    return !attempts.empty() && attempts.back().converged;
+}
+
+double Parameterizer::remainingBudget() const
+{
+    if (_timeBudget <= 0)
+    {
+        return 0;
+    }
+
+    // Keep it positive, a budget of 0 would be unbounded
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - _chartStart).count();
+
+    return std::max(DBL_MIN, _timeBudget - elapsed);
+}
+
+size_t Parameterizer::maxIterations(size_t numColumns) const
+{
+    const auto iterations = numColumns * 5;
+
+    return _maxIterations > 0 ? std::min(_maxIterations, iterations) : iterations;
 }
 
 void Parameterizer::setAnchors(const Chart& chart)
@@ -118,114 +1164,216 @@ void Parameterizer::setAnchors(const Chart& chart)
     _anchors = {{minUV, minV}, {maxUV, maxV}};
 }
 
-void Parameterizer::setCoefficients(const Chart& chart)
+// Each face adds its real and imaginary row to both columns of its free
+// vertices. Faces are visited by their row, which reordering may have moved
+// away from the chart's face order, so every column is filled sorted
+// without a triplet list or a sort of its entries.
+void Parameterizer::buildPattern(const Chart& chart)
 {
-    Mesh::Point pv[3];
-    VertexId vIds[3];
+    const auto& faces = chart.faces();
+    const auto numColumns = _vmap.size() * 2;
 
-    for (const auto& face : chart.faces())
+    _rows.resize(faces.size());
+    _slots.resize(faces.size() * 12);
+
+    std::vector<SparseMatrix::StorageIndex> next(numColumns + 1, 0);
+
+    for (auto f = 0; f < faces.size(); f++)
     {
-        const auto realRow = _fmap[face];
-        const auto imRow = realRow + 1;
+        _rows[f] = _fmap[faces[f]];
 
-        gatherAndProjectFace(face, pv, vIds);
-        
-        const auto pv01 = pv[1] - pv[0];
-        const auto pv02 = pv[2] - pv[0];
+        auto* slot = _slots.data() + f * 12;
+
+        auto fv_it = _mesh->fv_begin(faces[f]), fv_end = _mesh->fv_end(faces[f]);
+        for (; fv_it != fv_end; fv_it++, slot += 4)
+        {
+            if (isAnchor(*fv_it))
+            {
+                slot[0] = TopologyCache::FIXED;
+                continue;
+            }
 
-        // Real and Imaginary
-        setCoefficient(realRow, vIds[0], -pv01[0] + pv02[0], pv01[1] - pv02[1]);
-        setCoefficient(imRow, vIds[0], -pv01[1] + pv02[1], -pv01[0] + pv02[0]);
+            // Keep the column until its slots are known
+            const auto u = _vmap.at(*fv_it);
 
-        setCoefficient(realRow, vIds[1], -pv02[0], pv02[1]);
-        setCoefficient(imRow, vIds[1], -pv02[1], -pv02[0]);
+            slot[0] = u;
+            next[u + 1] += 2;
+            next[u + 2] += 2;
+        }
+    }
 
-        setCoefficient(realRow, vIds[2], pv01[0], 0);
-        setCoefficient(imRow, vIds[2], 0, pv01[0]);
+    for (auto i = 0; i < numColumns; i++)
+    {
+        next[i + 1] += next[i];
     }
 
-    for (const auto& anchor : _anchors)
+    _A.resize(_fmap.size() * 2, numColumns);
+    _A.resizeNonZeros(next[numColumns]);
+
+    std::copy(next.begin(), next.end(), _A.outerIndexPtr());
+
+    auto* inner = _A.innerIndexPtr();
+
+    std::vector<size_t> byRow(faces.size());
+    std::iota(byRow.begin(), byRow.end(), 0);
+    std::stable_sort(byRow.begin(), byRow.end(), [this](size_t a, size_t b) { return _rows[a] < _rows[b]; });
+
+    for (const auto f : byRow)
     {
-        const auto vId = id(anchor.h);
+        const auto realRow = (SparseMatrix::StorageIndex)_rows[f];
+        const auto imRow = realRow + 1;
+
+        auto* slot = _slots.data() + f * 12;
+
+        for (auto i = 0; i < 3; i++, slot += 4)
+        {
+            const auto u = slot[0];
+
+            if (u == TopologyCache::FIXED)
+            {
+                std::fill(slot, slot + 4, TopologyCache::FIXED);
+                continue;
+            }
+
+            slot[0] = next[u]++;
+            slot[2] = next[u]++;
+            slot[1] = next[u + 1]++;
+            slot[3] = next[u + 1]++;
 
-        _fx[vId.u] = anchor.uv[0];
-        _fx[vId.v] = anchor.uv[1];
+            inner[slot[0]] = realRow;
+            inner[slot[1]] = realRow;
+            inner[slot[2]] = imRow;
+            inner[slot[3]] = imRow;
+        }
     }
+
+    assert(SortedColumns(_A));
 }
 
-void Parameterizer::setCoefficient(size_t row, const VertexId& vId, double u, double v)
+// Every coefficient has its own slot and every face its own rows, so faces
+// are filled in parallel without sharing anything they write.
+void Parameterizer::setCoefficients(const Chart& chart, const std::vector<size_t>& rows, const std::vector<size_t>& slots, SparseMatrix& A)
 {
-    auto& a = isAnchor(vId.h) ? _fa : _a;
+    const auto& faces = chart.faces();
+    const auto numFaces = (std::ptrdiff_t)faces.size();
+
+    auto* values = A.valuePtr();
+
+    _e.resize(A.rows());
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t f = 0; f < numFaces; f++)
+    {
+        Mesh::Point pv[3];
+        Mesh::VertexHandle handles[3];
+        double re[3];
+        double im[3];
+
+        _frames.project(faces[f], pv);
+        FaceCoefficients(pv, re, im);
+
+        const auto* slot = slots.data() + f * 12;
+
+        // Only faces with pinned vertices need to look at the mesh
+        if (slot[0] == TopologyCache::FIXED || slot[4] == TopologyCache::FIXED || slot[8] == TopologyCache::FIXED)
+        {
+            auto i = 0;
+            auto fv_it = _mesh->fv_begin(faces[f]), fv_end = _mesh->fv_end(faces[f]);
+            for (; fv_it != fv_end; fv_it++, i++)
+            {
+                handles[i] = *fv_it;
+            }
+        }
+
+        // Pinned vertices move to the right hand side
+        auto real = 0.0;
+        auto imaginary = 0.0;
+
+        for (auto i = 0; i < 3; i++, slot += 4)
+        {
+            if (slot[0] == TopologyCache::FIXED)
+            {
+                const auto& anchor = getAnchor(handles[i]);
+
+                real -= re[i] * anchor.uv[0] + im[i] * anchor.uv[1];
+                imaginary -= -im[i] * anchor.uv[0] + re[i] * anchor.uv[1];
+                continue;
+            }
 
-    a.emplace_back(row, vId.u, u);
-    a.emplace_back(row, vId.v, v);
+            values[slot[0]] = re[i];
+            values[slot[1]] = im[i];
+            values[slot[2]] = -im[i];
+            values[slot[3]] = re[i];
+        }
+
+        _e[rows[f]] = real;
+        _e[rows[f] + 1] = imaginary;
+    }
 }
 
 void Parameterizer::storeUVs(const Chart& chart)
 {
-    auto& texCoords = chart.texCoords();
+    _uvs.resize(chart.vertices().size());
 
-    auto minUV = Mesh::TexCoord2D(MIN_DEFAULT, MIN_DEFAULT);
-    auto maxUV = Mesh::TexCoord2D(MAX_DEFAULT, MAX_DEFAULT);
-    
+    auto i = 0;
     for (const auto& vertex : chart.vertices())
     {
         auto vid = id(vertex);
-        
-        auto uv = Mesh::TexCoord2D();
 
         if (_amap.count(vertex) > 0)
         {
             auto anchor = getAnchor(vertex);
-            uv = Mesh::TexCoord2D(anchor.uv[0], anchor.uv[1]);
+            _uvs[i++] = Mesh::TexCoord2D(anchor.uv[0], anchor.uv[1]);
         }
         else
         {
-            uv = Mesh::TexCoord2D(_x(vid.u), _x(vid.v));
+            _uvs[i++] = Mesh::TexCoord2D(_x(vid.u), _x(vid.v));
         }
-        
-        minUV.minimize(uv);
-        maxUV.maximize(uv);
+    }
+
+    storeUVs(chart, _uvs.data());
+}
+
+void Parameterizer::storeUVs(const Chart& chart, const Mesh::TexCoord2D* uvs)
+{
+    auto& texCoords = chart.texCoords();
+    const auto& vertices = chart.vertices();
+
+    auto minUV = Mesh::TexCoord2D(MIN_DEFAULT, MIN_DEFAULT);
+    auto maxUV = Mesh::TexCoord2D(MAX_DEFAULT, MAX_DEFAULT);
+    
+    for (auto i = 0; i < vertices.size(); i++)
+    {
+        minUV.minimize(uvs[i]);
+        maxUV.maximize(uvs[i]);
     }
     
     auto diff = maxUV - minUV;
     const auto length = diff.max();
     
-    for (const auto& vertex : chart.vertices())
+    for (auto i = 0; i < vertices.size(); i++)
     {
-        auto vid = id(vertex);
-
-        auto uv = Mesh::TexCoord2D();
-
-        if (_amap.count(vertex) > 0)
-        {
-            auto anchor = getAnchor(vertex);
-            uv = Mesh::TexCoord2D(anchor.uv[0], anchor.uv[1]);
-        }
-        else
-        {
-            uv = Mesh::TexCoord2D(_x(vid.u), _x(vid.v));
-        }
-        
-        const auto nuv = (uv - minUV) / length;
+        const auto nuv = (uvs[i] - minUV) / length;
 
-        _mesh->property(texCoords, vertex) = nuv;
-        _mesh->set_texcoord2D(vertex, nuv);
+        _mesh->property(texCoords, vertices[i]) = nuv;
+        _mesh->set_texcoord2D(vertices[i], nuv);
     }
 }
 
 void Parameterizer::gatherAndProjectFace(const Mesh::FaceHandle& face, Mesh::Point* pv, Parameterizer::VertexId* vids)
 {
-    Mesh::Point v[3];
-    
     auto i = 0;
     auto v_it = _mesh->fv_begin(face), v_end = _mesh->fv_end(face);
     for (; v_it != v_end; v_it++, i++)
     {
-        v[i] = _mesh->point(*v_it);
         vids[i] = id(*v_it);
     }
-    
+
+    _frames.project(face, pv);
+}
+
+void Parameterizer::ProjectFace(const Mesh::Point* v, Mesh::Point* pv)
+{
     const auto v10 = v[1] - v[0];
     const auto v10Length = v10.length();
     const auto v20 = v[2] - v[0];
@@ -239,6 +1387,21 @@ void Parameterizer::gatherAndProjectFace(const Mesh::FaceHandle& face, Mesh::Poi
     pv[2] = Mesh::Point(v20 | x, v20 | y, 0);
 }
 
+void Parameterizer::FaceCoefficients(const Mesh::Point* pv, double* re, double* im)
+{
+    const auto pv01 = pv[1] - pv[0];
+    const auto pv02 = pv[2] - pv[0];
+
+    re[0] = -pv01[0] + pv02[0];
+    im[0] = pv01[1] - pv02[1];
+
+    re[1] = -pv02[0];
+    im[1] = pv02[1];
+
+    re[2] = pv01[0];
+    im[2] = 0;
+}
+
 void Parameterizer::findAxii(const Chart& chart, Mesh::Point* a)
 {
     auto min = Mesh::Point(MIN_DEFAULT, MIN_DEFAULT, MIN_DEFAULT);
@@ -321,6 +1484,103 @@ void Parameterizer::buildMaps(const Chart& chart)
             _vmap[vertex] = id;
         }
     }
+
+    if (_reorder)
+    {
+        reorder(chart);
+    }
+}
+
+// Renumbers the free vertices in reverse Cuthill-McKee order, then the faces
+// by their first vertex in that order, so neighbouring unknowns and the rows
+// that touch them sit close together in x and in A
+void Parameterizer::reorder(const Chart& chart)
+{
+    const auto& faces = chart.faces();
+    const auto numVertices = _vmap.size();
+    const size_t NONE = (size_t)-1;
+
+    std::vector<size_t> vertices(faces.size() * 3);
+
+    for (auto f = 0; f < faces.size(); f++)
+    {
+        auto i = 0;
+        auto fv_it = _mesh->fv_begin(faces[f]), fv_end = _mesh->fv_end(faces[f]);
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            vertices[f * 3 + i] = isAnchor(*fv_it) ? NONE : _vmap.at(*fv_it) / 2;
+        }
+    }
+
+    std::vector<std::vector<size_t>> neighbours(numVertices);
+
+    for (auto f = 0; f < faces.size(); f++)
+    {
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto a = vertices[f * 3 + i];
+            const auto b = vertices[f * 3 + (i + 1) % 3];
+
+            if (a != NONE && b != NONE)
+            {
+                neighbours[a].push_back(b);
+                neighbours[b].push_back(a);
+            }
+        }
+    }
+
+    std::vector<size_t> offsets(numVertices + 1, 0);
+    std::vector<size_t> adjacency;
+    adjacency.reserve(faces.size() * 6);
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        MeshUtil::Unique(neighbours[i]);
+
+        adjacency.insert(adjacency.end(), neighbours[i].begin(), neighbours[i].end());
+        offsets[i + 1] = adjacency.size();
+    }
+
+    const auto index = GraphOrdering::ReverseCuthillMcKee(offsets, adjacency);
+
+    for (auto& entry : _vmap)
+    {
+        entry.second = index[entry.second / 2] * 2;
+    }
+
+    std::vector<size_t> keys(faces.size());
+
+    for (auto f = 0; f < faces.size(); f++)
+    {
+        keys[f] = NONE;
+
+        for (auto i = 0; i < 3; i++)
+        {
+            const auto vertex = vertices[f * 3 + i];
+
+            if (vertex != NONE)
+            {
+                keys[f] = std::min(keys[f], index[vertex]);
+            }
+        }
+    }
+
+    std::vector<size_t> order(faces.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+    _fmap.clear();
+
+    for (const auto f : order)
+    {
+        if (_fmap.count(faces[f]) > 0)
+        {
+            continue;
+        }
+
+        const auto id = _fmap.size() * 2;
+        _fmap[faces[f]] = id;
+    }
 }
 
 Parameterizer::VertexId Parameterizer::id(const Mesh::VertexHandle& vertex)
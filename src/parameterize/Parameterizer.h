@@ -4,13 +4,31 @@
 #include "../util/MatrixDef.h"
 
 #include "../util/MeshDef.h"
+#include "../util/FaceFrames.h"
 
 #include "../charts/Chart.h"
 
+#include "ResultCache.h"
+#include "SolveReport.h"
+#include "TopologyCache.h"
+
+#include <chrono>
+
 using namespace Charts;
 
 class Parameterizer
 {
+public:
+    enum class Engine
+    {
+        // Least squares conformal map pinned at two anchors
+        LSCM,
+
+        // Free-boundary conformal map from the smallest eigenvector of the
+        // conformal energy, without anchors
+        Spectral
+    };
+
 private:
     struct VertexId
     {
@@ -28,20 +46,25 @@ private:
     typedef std::map<Mesh::VertexHandle, size_t> VertexMap;
     typedef std::map<Mesh::FaceHandle, size_t> FaceMap;
     typedef std::vector<Anchor> AnchorList;
+    typedef std::chrono::steady_clock Clock;
     
     Mesh* _mesh;
     const std::vector<Chart>* _charts;
 
-    TripletList _a;
     SparseMatrix _A;
     MatrixXx1 _x;
 
-    TripletList _fa;
-    SparseMatrix _fA;
-    MatrixXx1 _fx;
-
     MatrixXx1 _e;
 
+    // First row of each chart face, and the value index in _A of each of
+    // its 12 coefficients, laid out as in TopologyCache::Entry
+    std::vector<size_t> _rows;
+    std::vector<size_t> _slots;
+
+    std::vector<Mesh::TexCoord2D> _uvs;
+
+    FaceFrames _frames;
+
     Eigen::LeastSquaresConjugateGradient<Eigen::SparseMatrix<double>> _solver;
 
     VertexMap _vmap;
@@ -49,25 +72,128 @@ private:
     FaceMap _fmap;
 
     AnchorList _anchors;
+
+    bool _matrixFree;
+    bool _reorder;
+
+    TopologyCache* _topologyCache;
+    ResultCache* _resultCache;
+
+    size_t _texelResolution;
+    float _texelTolerance;
+    double _texelSize;
+
+    size_t _multilevelFaces;
+    size_t _smoothingIterations;
+    float _uvTolerance;
+    bool _mixedPrecision;
+
+    double _timeBudget;
+    size_t _maxIterations;
+
+    Engine _engine;
+    std::map<size_t, Engine> _chartEngines;
+
+    std::vector<SolveReport> _reports;
+    Clock::time_point _chartStart;
+    Clock::time_point _attemptStart;
     
 public:
     Parameterizer(Mesh* mesh, const std::vector<Chart>* charts);
 
+    // Solves charts without assembling the sparse system, applying it face
+    // by face instead.
+    void setMatrixFree(bool matrixFree);
+
+    // Stops the multilevel solve of a chart once no vertex can move by more
+    // than the given fraction of a texel in an atlas of this resolution. A
+    // resolution of 0 keeps the tolerance relative to the chart size.
+    void setTexelTolerance(size_t resolution, float texels = 0.1f);
+
+    // Orders each chart's unknowns and rows by reverse Cuthill-McKee over
+    // its vertices, instead of the order faces first reach them, so the
+    // sparse products of the solve read memory close together. On by default.
+    void setReordering(bool reorder);
+
+    // Reuses the index maps and sparsity pattern of charts whose topology
+    // is already in the cache, and stores the ones that are not. The cache
+    // can be shared by Parameterizers run over new vertex positions, or
+    // kept on disk for later runs. Multilevel and matrix-free charts are
+    // not cached.
+    void setTopologyCache(TopologyCache* cache);
+
+    // Reuses the UVs of charts whose intrinsic geometry was solved before,
+    // in this run or an earlier one, with the same engine and solver
+    // settings, and stores the ones that were not
+    void setResultCache(ResultCache* cache);
+
+    // Charts with at least minFaces faces are solved coarse-to-fine. A
+    // value of 0 disables the multilevel solver.
+    void setMultilevel(size_t minFaces, size_t smoothingIterations = 1, float uvTolerance = 0.001f);
+
+    // Runs the multilevel preconditioner in single precision, while the
+    // outer iterations keep the solution accurate to double precision.
+    void setMixedPrecision(bool mixedPrecision);
+
+    // Bounds the iterative solve of each chart. Charts that do not converge
+    // within it fall back to a direct solve, then to a direct solve pinned
+    // at other anchors, then to a planar projection. 0 leaves either bound
+    // at its default.
+    void setBudget(double seconds, size_t maxIterations = 0);
+
+    // Engine of every chart, unless set for the chart by its id. Charts
+    // the spectral engine fails on are solved with LSCM.
+    void setEngine(Engine engine);
+    void setEngine(size_t chartId, Engine engine);
+
+    // How each chart of the last build was solved
+    const std::vector<SolveReport>& reports() const;
+
     void build();
 
+    // Local frames and areas of the mesh's faces, as of the last build
+    const FaceFrames& faceFrames() const;
+
+    static void ProjectFace(const Mesh::Point* v, Mesh::Point* pv);
+    static void FaceCoefficients(const Mesh::Point* pv, double* re, double* im);
+
 private:
     void build(const Chart& chart);
+    void solve(const Chart& chart);
+    Engine engine(const Chart& chart) const;
+    uint64_t solveSettings(const Chart& chart) const;
+    bool buildSmall(const Chart& chart);
+    bool buildCached(const Chart& chart, size_t hash);
+    void cacheTopology(const Chart& chart, size_t hash);
+    std::vector<int> topology(const Chart& chart) const;
+    void buildMatrixFree(const Chart& chart);
+    void buildMultilevel(const Chart& chart);
+    bool buildSpectral(const Chart& chart);
+
+    void solveLeastSquares(const SparseMatrix& A, MatrixXx1& x);
+
+    void fallback(const Chart& chart);
+    bool solveDirect(const Chart& chart, SolveMethod method);
+    void solvePlanar(const Chart& chart);
+    void reanchor(const Chart& chart);
+
+    void record(SolveMethod method, size_t iterations, double error, bool converged);
+    bool isConverged() const;
+    double remainingBudget() const;
+    size_t maxIterations(size_t numColumns) const;
 
     void setAnchors(const Chart& chart);
-    void setCoefficients(const Chart& chart);
-    void setCoefficient(size_t row, const VertexId& vId, double u, double v);
+    void buildPattern(const Chart& chart);
+    void setCoefficients(const Chart& chart, const std::vector<size_t>& rows, const std::vector<size_t>& slots, SparseMatrix& A);
     void storeUVs(const Chart& chart);
+    void storeUVs(const Chart& chart, const Mesh::TexCoord2D* uvs);
     
     void gatherAndProjectFace(const Mesh::FaceHandle& face, Mesh::Point* pv, VertexId* ids);
     
     void findAxii(const Chart& chart, Mesh::Point* a);
     
     void buildMaps(const Chart& chart);
+    void reorder(const Chart& chart);
     
     VertexId id(const Mesh::VertexHandle& vertex);
 
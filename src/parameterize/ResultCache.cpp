@@ -0,0 +1,192 @@
+//
+//  ResultCache.cpp
+//  LSCM
+//
+//  Each file holds a version tag, the key, the settings, then the UVs as
+//  float pairs. It is written under a name of its own and renamed, so
+//  concurrent runs never read a partial file.
+//
+
+#include "ResultCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+// "LSCMRC02" in little endian
+const uint64_t FILE_TAG = 0x323043524d43534cull;
+
+namespace
+{
+    template<typename T>
+    void Write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void Write(std::ostream& out, const std::vector<T>& values)
+    {
+        Write(out, (uint64_t)values.size());
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    bool Read(std::istream& in, T& value)
+    {
+        return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    // Only reads as many values as expected, so a damaged file fails
+    // instead of allocating whatever its size field says
+    template<typename T>
+    bool Read(std::istream& in, std::vector<T>& values, size_t expected)
+    {
+        uint64_t size = 0;
+
+        if (!Read(in, size) || size != expected)
+        {
+            return false;
+        }
+
+        values.resize(size);
+
+        return (bool)in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+    }
+
+    // A name no other run writes to, so runs storing the same entry at once
+    // each rename a whole file of their own over the target
+    std::string TemporaryPath(const std::string& target)
+    {
+        std::random_device random;
+
+        std::stringstream path;
+        path << target << "." << std::hex << random() << random() << ".tmp";
+
+        return path.str();
+    }
+}
+
+ResultCache::ResultCache(const std::string& directory)
+: _directory(directory)
+, _lookups(0)
+, _hits(0)
+, _stores(0)
+{
+}
+
+bool ResultCache::find(const IntrinsicKey& key, uint64_t settings, std::vector<Mesh::TexCoord2D>& uvs)
+{
+    _lookups++;
+
+    std::ifstream in(path(key, settings), std::ios::binary);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    uint64_t tag = 0;
+    IntrinsicKey stored;
+    uint64_t storedSettings = 0;
+
+    auto valid = Read(in, tag) && tag == FILE_TAG
+        && Read(in, stored.numVertices) && Read(in, stored.meanLength) && Read(in, stored.hash)
+        && Read(in, stored.faces, key.faces.size())
+        && Read(in, stored.lengths, key.lengths.size())
+        && Read(in, storedSettings);
+
+    // Equal hashes are not enough, the whole key has to match
+    if (!valid || !stored.matches(key) || storedSettings != settings)
+    {
+        return false;
+    }
+
+    std::vector<float> values;
+
+    if (!Read(in, values, key.numVertices * 2))
+    {
+        return false;
+    }
+
+    uvs.resize(key.numVertices);
+
+    for (auto i = 0; i < uvs.size(); i++)
+    {
+        uvs[i] = Mesh::TexCoord2D(values[i * 2], values[i * 2 + 1]);
+    }
+
+    _hits++;
+
+    return true;
+}
+
+void ResultCache::store(const IntrinsicKey& key, uint64_t settings, const std::vector<Mesh::TexCoord2D>& uvs)
+{
+    const auto target = path(key, settings);
+    const auto temporary = TemporaryPath(target);
+
+    std::vector<float> values;
+    values.reserve(uvs.size() * 2);
+
+    for (const auto& uv : uvs)
+    {
+        values.push_back(uv[0]);
+        values.push_back(uv[1]);
+    }
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+        Write(out, FILE_TAG);
+        Write(out, key.numVertices);
+        Write(out, key.meanLength);
+        Write(out, key.hash);
+        Write(out, key.faces);
+        Write(out, key.lengths);
+        Write(out, settings);
+        Write(out, values);
+
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), target.c_str()) == 0)
+    {
+        _stores++;
+    }
+    else
+    {
+        std::remove(temporary.c_str());
+    }
+}
+
+size_t ResultCache::lookups() const
+{
+    return _lookups;
+}
+
+size_t ResultCache::hits() const
+{
+    return _hits;
+}
+
+size_t ResultCache::stores() const
+{
+    return _stores;
+}
+
+std::string ResultCache::path(const IntrinsicKey& key, uint64_t settings) const
+{
+    // Charts solved other ways are kept side by side
+    std::stringstream path;
+    path << _directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key.hash
+        << "-" << std::setw(16) << settings << ".uv";
+
+    return path.str();
+}
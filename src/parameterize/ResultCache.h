@@ -0,0 +1,39 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/IntrinsicKey.h"
+#include "../util/MeshDef.h"
+
+// Solved UVs of charts on disk, one file per chart in a directory, named by
+// the hash of the chart's intrinsic geometry and of the settings it was
+// solved with. Every file keeps the full key and the settings, so UVs are
+// only reused when the geometry matches exactly and the chart was solved
+// the same way.
+class ResultCache
+{
+private:
+    std::string _directory;
+
+    size_t _lookups;
+    size_t _hits;
+    size_t _stores;
+
+public:
+    // The directory must exist
+    explicit ResultCache(const std::string& directory);
+
+    // UVs in the order of the vertex list the key was built from. settings
+    // is a hash of the engine and solver settings the UVs come from.
+    bool find(const IntrinsicKey& key, uint64_t settings, std::vector<Mesh::TexCoord2D>& uvs);
+    void store(const IntrinsicKey& key, uint64_t settings, const std::vector<Mesh::TexCoord2D>& uvs);
+
+    size_t lookups() const;
+    size_t hits() const;
+    size_t stores() const;
+
+private:
+    std::string path(const IntrinsicKey& key, uint64_t settings) const;
+};
@@ -0,0 +1,68 @@
+//
+//  SolveReport.cpp
+//  LSCM
+//
+
+#include "SolveReport.h"
+
+bool SolveReport::isFallback() const
+{
+    return attempts.size() > 1;
+}
+
+double SolveReport::seconds() const
+{
+    auto total = 0.0;
+
+    for (const auto& attempt : attempts)
+    {
+        total += attempt.seconds;
+    }
+
+    return total;
+}
+
+const char* SolveReport::MethodName(SolveMethod method)
+{
+    switch (method)
+    {
+        case SolveMethod::Cached:
+            return "cached";
+        case SolveMethod::Small:
+            return "small";
+        case SolveMethod::Iterative:
+            return "iterative";
+        case SolveMethod::MatrixFree:
+            return "matrix-free";
+        case SolveMethod::Multilevel:
+            return "multilevel";
+        case SolveMethod::Spectral:
+            return "spectral";
+        case SolveMethod::Direct:
+            return "direct";
+        case SolveMethod::Reanchored:
+            return "reanchored";
+        case SolveMethod::Planar:
+            return "planar";
+    }
+
+    return "";
+}
+
+void SolveReport::WriteCSV(std::ostream& out, const std::vector<SolveReport>& reports)
+{
+    out << "chart,method,iterations,error,seconds,converged" << std::endl;
+
+    for (const auto& report : reports)
+    {
+        for (const auto& attempt : report.attempts)
+        {
+            out << report.chart << ","
+                << MethodName(attempt.method) << ","
+                << attempt.iterations << ","
+                << attempt.error << ","
+                << attempt.seconds << ","
+                << (attempt.converged ? 1 : 0) << std::endl;
+        }
+    }
+}
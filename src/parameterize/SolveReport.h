@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+enum class SolveMethod
+{
+    Cached,
+    Small,
+    Iterative,
+    MatrixFree,
+    Multilevel,
+    Spectral,
+    Direct,
+    Reanchored,
+    Planar
+};
+
+struct SolveAttempt
+{
+    SolveMethod method;
+    size_t iterations;
+    double error;
+    double seconds;
+    bool converged;
+};
+
+// Every solve attempted for a chart, in order. The UVs stored for the
+// chart come from the last attempt.
+struct SolveReport
+{
+    size_t chart;
+    std::vector<SolveAttempt> attempts;
+
+    // Whether the first method tried did not give the chart's UVs
+    bool isFallback() const;
+
+    double seconds() const;
+
+    static const char* MethodName(SolveMethod method);
+
+    // One line per attempt: chart, method, iterations, error, seconds, converged
+    static void WriteCSV(std::ostream& out, const std::vector<SolveReport>& reports);
+};
@@ -0,0 +1,221 @@
+//
+//  SpectralSolver.cpp
+//  LSCM
+//
+//  Referenced:
+//  Spectral Conformal Parameterization - Mullen et al
+//  https://www.geometry.caltech.edu/pubs/MTAD08.pdf
+//
+//  Restarted Lanczos on (L - σB)⁻¹B, with a shift just below 0. L - σB is
+//  then definite, so it is factored once and every iteration is a pair of
+//  triangular solves. The null space of L is the largest eigenvalue of the
+//  operator and is projected out of every vector, leaving the smallest
+//  nonzero one to the Rayleigh-Ritz step that ends each restart.
+//
+
+#include "SpectralSolver.h"
+
+#include <cfloat>
+#include <chrono>
+
+// Shift below 0, relative to the mean diagonal of L over that of B
+const double SHIFT = 0.000001;
+
+const size_t DEFAULT_MAX_ITERATIONS = 1000;
+
+// Vectors in the Krylov basis, before restarting from its best Ritz vector
+const int KRYLOV_SIZE = 16;
+
+// B-norm, relative to the norm, below which a new vector adds nothing
+const double BREAKDOWN = 0.0000000001;
+
+SpectralSolver::SpectralSolver(const SparseMatrix* L, const MatrixXx1* B)
+: _L(L)
+, _B(B)
+, _threshold(0.000001)
+, _maxIterations(0)
+, _timeBudget(0)
+, _iterations(0)
+, _eigenvalue(0)
+, _error(0)
+, _converged(false)
+{
+}
+
+void SpectralSolver::setThreshold(double threshold)
+{
+    _threshold = threshold;
+}
+
+void SpectralSolver::setBudget(double seconds, size_t maxIterations)
+{
+    _timeBudget = seconds;
+    _maxIterations = maxIterations;
+}
+
+size_t SpectralSolver::iterations() const
+{
+    return _iterations;
+}
+
+double SpectralSolver::eigenvalue() const
+{
+    return _eigenvalue;
+}
+
+double SpectralSolver::error() const
+{
+    return _error;
+}
+
+bool SpectralSolver::converged() const
+{
+    return _converged;
+}
+
+void SpectralSolver::solve(MatrixXx1& x)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto& L = *_L;
+    const auto& B = *_B;
+
+    _iterations = 0;
+    _eigenvalue = 0;
+    _error = 0;
+    _converged = false;
+
+    const auto massTrace = B.sum();
+
+    // A chart without a boundary has no free-boundary map
+    if (!(massTrace > 0) || !B.allFinite() || !Eigen::Map<const MatrixXx1>(L.valuePtr(), L.nonZeros()).allFinite())
+    {
+        return;
+    }
+
+    const auto shift = SHIFT * L.diagonal().sum() / massTrace;
+
+    SparseMatrix shifted = L;
+    shifted.diagonal() += shift * B;
+
+    _solver.compute(shifted);
+
+    if (_solver.info() != Eigen::Success)
+    {
+        return;
+    }
+
+    const auto maxIterations = _maxIterations > 0 ? _maxIterations : DEFAULT_MAX_ITERATIONS;
+    const auto numColumns = x.size();
+
+    MatrixX V(numColumns, KRYLOV_SIZE);
+    MatrixX LV;
+    MatrixXx1 w;
+    MatrixXx1 Bw;
+    MatrixXx1 Lx;
+
+    deflate(x);
+
+    while (_iterations < maxIterations)
+    {
+        // B-orthonormal basis of the Krylov space of (L - σB)⁻¹B from x
+        auto norm = std::sqrt(x.dot(B.cwiseProduct(x)));
+
+        if (!(norm > 0) || !x.allFinite())
+        {
+            return;
+        }
+
+        V.col(0) = x / norm;
+
+        auto size = 1;
+
+        for (; size < KRYLOV_SIZE && _iterations < maxIterations; size++)
+        {
+            Bw = B.cwiseProduct(V.col(size - 1));
+            w = _solver.solve(Bw);
+            deflate(w);
+
+            _iterations++;
+
+            // Twice is enough to keep the basis orthogonal
+            for (auto pass = 0; pass < 2; pass++)
+            {
+                Bw = B.cwiseProduct(w);
+                w -= V.leftCols(size) * (V.leftCols(size).transpose() * Bw);
+            }
+
+            norm = std::sqrt(w.dot(B.cwiseProduct(w)));
+
+            // The basis already spans an invariant subspace
+            if (!(norm > BREAKDOWN * w.norm()) || !w.allFinite())
+            {
+                break;
+            }
+
+            V.col(size) = w / norm;
+        }
+
+        // Rayleigh-Ritz, the basis being B-orthonormal leaves a standard
+        // eigenproblem
+        LV = L * V.leftCols(size);
+        const MatrixX T = V.leftCols(size).transpose() * LV;
+
+        Eigen::SelfAdjointEigenSolver<MatrixX> ritz(T);
+
+        if (ritz.info() != Eigen::Success)
+        {
+            return;
+        }
+
+        const MatrixXx1 y = ritz.eigenvectors().col(0);
+
+        x = V.leftCols(size) * y;
+        Lx = LV * y;
+        Bw = B.cwiseProduct(x);
+
+        _eigenvalue = ritz.eigenvalues()[0];
+        _error = (Lx - _eigenvalue * Bw).norm() / std::max(DBL_MIN, (Lx + shift * Bw).norm());
+
+        if (_error <= _threshold)
+        {
+            _converged = true;
+            return;
+        }
+
+        if (_timeBudget > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > _timeBudget)
+        {
+            return;
+        }
+    }
+}
+
+// Makes x B-orthogonal to the constant u and v vectors
+void SpectralSolver::deflate(MatrixXx1& x) const
+{
+    const auto& B = *_B;
+    const auto numVertices = x.size() / 2;
+
+    double mass[2] = {0, 0};
+    double mean[2] = {0, 0};
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        for (auto c = 0; c < 2; c++)
+        {
+            mass[c] += B[i * 2 + c];
+            mean[c] += B[i * 2 + c] * x[i * 2 + c];
+        }
+    }
+
+    for (auto c = 0; c < 2; c++)
+    {
+        mean[c] /= mass[c];
+    }
+
+    for (auto i = 0; i < numVertices; i++)
+    {
+        x[i * 2] -= mean[0];
+        x[i * 2 + 1] -= mean[1];
+    }
+}
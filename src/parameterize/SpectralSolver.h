@@ -0,0 +1,52 @@
+
+#pragma once
+
+#include "../util/MatrixDef.h"
+
+// Solves L x = λ B x for the eigenvector of smallest nonzero λ, where L is
+// the normal matrix of a chart's unpinned conformal energy and B the mass
+// of its boundary. The constant u and v vectors span the null space of L,
+// and any vector of the smallest eigenspace is a conformal map of the
+// chart, up to a rotation and scale.
+class SpectralSolver
+{
+private:
+    const SparseMatrix* _L;
+    const MatrixXx1* _B;
+
+    Eigen::SimplicialLDLT<SparseMatrix> _solver;
+
+    double _threshold;
+
+    size_t _maxIterations;
+    double _timeBudget;
+
+    size_t _iterations;
+    double _eigenvalue;
+    double _error;
+    bool _converged;
+
+public:
+    // B holds the diagonal of the mass matrix. Both are indexed by
+    // interleaved (u, v) columns, as for MultilevelSolver.
+    SpectralSolver(const SparseMatrix* L, const MatrixXx1* B);
+
+    // Residual ‖Lx - λBx‖, relative to ‖(L - σB)x‖, at which the
+    // iterations stop
+    void setThreshold(double threshold);
+
+    // Stops the iterations after this many seconds or iterations, 0 leaves
+    // the time unbounded and the iterations at their default
+    void setBudget(double seconds, size_t maxIterations);
+
+    size_t iterations() const;
+    double eigenvalue() const;
+    double error() const;
+    bool converged() const;
+
+    // x holds the starting vector, and the eigenvector once solved
+    void solve(MatrixXx1& x);
+
+private:
+    void deflate(MatrixXx1& x) const;
+};
@@ -0,0 +1,384 @@
+//
+//  TopologyCache.cpp
+//  LSCM
+//
+//  Each file holds a version tag, the topology, then the anchors, maps and
+//  sparsity pattern of the entry. Values of A are not kept, they are set
+//  from the vertex positions of every run. Files are written under a name
+//  of their own and renamed, so concurrent runs never read a partial file.
+//
+
+#include "TopologyCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+// "LSCMTC01" in little endian
+const uint64_t FILE_TAG = 0x313043544d43534cull;
+
+const size_t TopologyCache::FIXED = (size_t)-1;
+
+namespace
+{
+    template<typename T>
+    void Write(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    void Write(std::ostream& out, const T* values, size_t size)
+    {
+        Write(out, (uint64_t)size);
+        out.write(reinterpret_cast<const char*>(values), size * sizeof(T));
+    }
+
+    template<typename T>
+    bool Read(std::istream& in, T& value)
+    {
+        return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+
+    // Only reads as many values as the file could hold, so a damaged file
+    // fails instead of allocating whatever its size field says
+    template<typename T>
+    bool Read(std::istream& in, std::vector<T>& values, uint64_t fileSize)
+    {
+        uint64_t size = 0;
+
+        if (!Read(in, size) || size > fileSize / sizeof(T))
+        {
+            return false;
+        }
+
+        values.resize(size);
+
+        return (bool)in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+    }
+
+    bool ValidIndex(size_t index, size_t size)
+    {
+        return index == TopologyCache::FIXED || index < size;
+    }
+
+    // A name no other run writes to, so runs storing the same entry at once
+    // each rename a whole file of their own over the target
+    std::string TemporaryPath(const std::string& target)
+    {
+        std::random_device random;
+
+        std::stringstream path;
+        path << target << "." << std::hex << random() << random() << ".tmp";
+
+        return path.str();
+    }
+}
+
+TopologyCache::TopologyCache(const std::string& directory)
+: _directory(directory)
+, _lookups(0)
+, _hits(0)
+{
+}
+
+TopologyCache::Entry* TopologyCache::find(size_t hash, const std::vector<int>& topology)
+{
+    _lookups++;
+
+    auto iter = _entries.find(hash);
+
+    if (iter == _entries.end())
+    {
+        Entry entry;
+
+        if (_directory.empty() || !read(hash, entry))
+        {
+            return nullptr;
+        }
+
+        iter = _entries.emplace(hash, std::move(entry)).first;
+    }
+
+    // Equal hashes are not enough, the whole topology has to match
+    if (!Validate(iter->second, topology))
+    {
+        return nullptr;
+    }
+
+    _hits++;
+
+    return &iter->second;
+}
+
+void TopologyCache::store(size_t hash, const Entry& entry)
+{
+    _entries[hash] = entry;
+
+    if (!_directory.empty())
+    {
+        write(hash, entry);
+    }
+}
+
+size_t TopologyCache::size() const
+{
+    return _entries.size();
+}
+
+size_t TopologyCache::lookups() const
+{
+    return _lookups;
+}
+
+size_t TopologyCache::hits() const
+{
+    return _hits;
+}
+
+void TopologyCache::clear()
+{
+    _entries.clear();
+}
+
+bool TopologyCache::Validate(const Entry& entry, const std::vector<int>& topology)
+{
+    if (entry.topology != topology || topology.empty() || topology[0] < 0)
+    {
+        return false;
+    }
+
+    const auto numFaces = (size_t)topology[0];
+    const auto vertices = topology.begin() + 1 + numFaces * 4;
+
+    if (entry.rows.size() != numFaces || entry.slots.size() != numFaces * 12 || entry.columns.size() != (size_t)(topology.end() - vertices))
+    {
+        return false;
+    }
+
+    const auto& A = entry.A;
+
+    if (!A.isCompressed() || A.rows() != (Eigen::Index)numFaces * 2 || A.cols() % 2 != 0 || entry.x.size() != A.cols())
+    {
+        return false;
+    }
+
+    // Anchors are distinct chart vertices, and exactly their columns and
+    // slots are pinned, as the solve looks every pinned vertex up among them
+    std::vector<int> anchors;
+
+    for (const auto& anchor : entry.anchors)
+    {
+        if (std::find(vertices, topology.end(), anchor.idx()) == topology.end())
+        {
+            return false;
+        }
+
+        anchors.push_back(anchor.idx());
+    }
+
+    std::sort(anchors.begin(), anchors.end());
+
+    if (std::adjacent_find(anchors.begin(), anchors.end()) != anchors.end())
+    {
+        return false;
+    }
+
+    const auto isAnchor = [&anchors](int vertex)
+    {
+        return std::binary_search(anchors.begin(), anchors.end(), vertex);
+    };
+
+    auto numFixed = (size_t)0;
+
+    for (size_t i = 0; i < entry.columns.size(); i++)
+    {
+        const auto column = entry.columns[i];
+
+        if (!ValidIndex(column, (size_t)A.cols()) || (column != FIXED && column % 2 != 0)
+            || (column == FIXED) != isAnchor(vertices[i]))
+        {
+            return false;
+        }
+
+        numFixed += column == FIXED ? 1 : 0;
+    }
+
+    if (numFixed != anchors.size())
+    {
+        return false;
+    }
+
+    for (size_t f = 0; f < numFaces; f++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            const auto pinned = isAnchor(topology[2 + f * 4 + i]);
+            const auto* slot = entry.slots.data() + f * 12 + i * 4;
+
+            for (auto k = 0; k < 4; k++)
+            {
+                if ((slot[k] == FIXED) != pinned)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    for (const auto row : entry.rows)
+    {
+        if (row % 2 != 0 || row + 1 >= (size_t)A.rows())
+        {
+            return false;
+        }
+    }
+
+    for (const auto slot : entry.slots)
+    {
+        if (!ValidIndex(slot, (size_t)A.nonZeros()))
+        {
+            return false;
+        }
+    }
+
+    const auto* outer = A.outerIndexPtr();
+    const auto* inner = A.innerIndexPtr();
+
+    if (outer[0] != 0 || outer[A.cols()] != A.nonZeros())
+    {
+        return false;
+    }
+
+    for (auto j = 0; j < A.cols(); j++)
+    {
+        if (outer[j + 1] < outer[j])
+        {
+            return false;
+        }
+
+        for (auto k = outer[j]; k < outer[j + 1]; k++)
+        {
+            if (inner[k] < 0 || inner[k] >= A.rows() || (k > outer[j] && inner[k] <= inner[k - 1]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TopologyCache::read(size_t hash, Entry& entry) const
+{
+    std::ifstream in(path(hash), std::ios::binary | std::ios::ate);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    const auto fileSize = (uint64_t)in.tellg();
+    in.seekg(0);
+
+    uint64_t tag = 0;
+    std::vector<int> anchors;
+    std::vector<uint64_t> columns;
+    std::vector<uint64_t> rows;
+    std::vector<uint64_t> slots;
+    int64_t numRows = 0;
+    int64_t numColumns = 0;
+    std::vector<SparseMatrix::StorageIndex> outer;
+    std::vector<SparseMatrix::StorageIndex> inner;
+    std::vector<double> x;
+
+    const auto valid = Read(in, tag) && tag == FILE_TAG
+        && Read(in, entry.topology, fileSize) && Read(in, anchors, fileSize)
+        && Read(in, columns, fileSize) && Read(in, rows, fileSize) && Read(in, slots, fileSize)
+        && Read(in, numRows) && Read(in, numColumns)
+        && Read(in, outer, fileSize) && Read(in, inner, fileSize) && Read(in, x, fileSize)
+        && numRows >= 0 && numColumns >= 0 && outer.size() == (size_t)numColumns + 1
+        && x.size() == (size_t)numColumns && !inner.empty() && outer.back() == (SparseMatrix::StorageIndex)inner.size();
+
+    if (!valid)
+    {
+        return false;
+    }
+
+    for (const auto anchor : anchors)
+    {
+        entry.anchors.push_back(Mesh::VertexHandle(anchor));
+    }
+
+    entry.columns.assign(columns.begin(), columns.end());
+    entry.rows.assign(rows.begin(), rows.end());
+    entry.slots.assign(slots.begin(), slots.end());
+
+    entry.A.resize(numRows, numColumns);
+    entry.A.resizeNonZeros(inner.size());
+
+    std::copy(outer.begin(), outer.end(), entry.A.outerIndexPtr());
+    std::copy(inner.begin(), inner.end(), entry.A.innerIndexPtr());
+    std::fill(entry.A.valuePtr(), entry.A.valuePtr() + inner.size(), 0.0);
+
+    entry.x = Eigen::Map<MatrixXx1>(x.data(), x.size());
+
+    return true;
+}
+
+void TopologyCache::write(size_t hash, const Entry& entry) const
+{
+    const auto target = path(hash);
+    const auto temporary = TemporaryPath(target);
+
+    std::vector<int> anchors;
+
+    for (const auto& anchor : entry.anchors)
+    {
+        anchors.push_back(anchor.idx());
+    }
+
+    const std::vector<uint64_t> columns(entry.columns.begin(), entry.columns.end());
+    const std::vector<uint64_t> rows(entry.rows.begin(), entry.rows.end());
+    const std::vector<uint64_t> slots(entry.slots.begin(), entry.slots.end());
+
+    const auto& A = entry.A;
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+        Write(out, FILE_TAG);
+        Write(out, entry.topology.data(), entry.topology.size());
+        Write(out, anchors.data(), anchors.size());
+        Write(out, columns.data(), columns.size());
+        Write(out, rows.data(), rows.size());
+        Write(out, slots.data(), slots.size());
+        Write(out, (int64_t)A.rows());
+        Write(out, (int64_t)A.cols());
+        Write(out, A.outerIndexPtr(), (size_t)A.cols() + 1);
+        Write(out, A.innerIndexPtr(), (size_t)A.nonZeros());
+        Write(out, entry.x.data(), (size_t)entry.x.size());
+
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), target.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+    }
+}
+
+std::string TopologyCache::path(size_t hash) const
+{
+    std::stringstream path;
+    path << _directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".topology";
+
+    return path.str();
+}
@@ -0,0 +1,82 @@
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../util/MatrixDef.h"
+#include "../util/MeshDef.h"
+
+// Keeps the parts of a chart's LSCM system that only depend on its
+// topology, so charts that are solved again with new vertex positions
+// only need numeric assembly and the solve. Entries live in memory, and
+// in a directory when one is given, one file per chart named by the hash
+// of its topology, so later runs over the same mesh reuse them too.
+class TopologyCache
+{
+public:
+    // Slot of a coefficient that belongs to an anchor
+    static const size_t FIXED;
+
+    struct Entry
+    {
+        // The face count, each face's index and vertex indices, then the
+        // chart's vertex indices. An entry is only used for a chart with
+        // exactly this topology, whatever its hash.
+        std::vector<int> topology;
+
+        VertexList anchors;
+
+        // Column of each chart vertex, in chart order
+        std::vector<size_t> columns;
+
+        // First row of each chart face
+        std::vector<size_t> rows;
+
+        // Value index in A of each coefficient, 12 per face: the real row's
+        // (u, v) and then the imaginary row's (u, v) for each vertex
+        std::vector<size_t> slots;
+
+        SparseMatrix A;
+
+        // Previous solution, used as the initial guess
+        MatrixXx1 x;
+    };
+
+private:
+    std::string _directory;
+
+    std::map<size_t, Entry> _entries;
+
+    size_t _lookups;
+    size_t _hits;
+
+public:
+    // The directory must exist, an empty one keeps entries in memory only
+    explicit TopologyCache(const std::string& directory = "");
+
+    // The entry of a chart with this topology, checked against the chart
+    // and its own pattern, or nullptr
+    Entry* find(size_t hash, const std::vector<int>& topology);
+
+    // Keeps the entry, replacing any of the same hash
+    void store(size_t hash, const Entry& entry);
+
+    size_t size() const;
+
+    size_t lookups() const;
+    size_t hits() const;
+
+    void clear();
+
+    // Whether the entry fits the topology and its indices stay within its
+    // own matrix, with the rows of every column in order
+    static bool Validate(const Entry& entry, const std::vector<int>& topology);
+
+private:
+    bool read(size_t hash, Entry& entry) const;
+    void write(size_t hash, const Entry& entry) const;
+
+    std::string path(size_t hash) const;
+};
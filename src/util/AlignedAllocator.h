@@ -0,0 +1,66 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Allocator for standard containers whose storage starts on an Alignment
+// byte boundary, so vector loads from the start never split a cache line.
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        // Room to align the block and to keep the pointer malloc returned
+        // just before it
+        auto raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void*));
+
+        if (!raw)
+        {
+            throw std::bad_alloc();
+        }
+
+        const auto address = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+        reinterpret_cast<void**>(address)[-1] = raw;
+
+        return reinterpret_cast<T*>(address);
+    }
+
+    void deallocate(T* p, size_t)
+    {
+        if (p)
+        {
+            std::free(reinterpret_cast<void**>(p)[-1]);
+        }
+    }
+};
+
+template<typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return true;
+}
+
+template<typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&)
+{
+    return false;
+}
@@ -0,0 +1,244 @@
+//
+//  Calipers.cpp
+//  LSCM
+//
+//  Referenced:
+//  Solving Geometric Problems with the Rotating Calipers - Toussaint
+//  Another Efficient Algorithm for Convex Hulls in Two Dimensions - Andrew
+//
+//  The bounding box of least area, and the least width, both have a side
+//  along an edge of the hull, so only the hull's edges are tried. The
+//  extreme points along and across each edge only move forward around the
+//  hull as the edges turn, so all the edges are measured in one pass.
+//
+
+#include "Calipers.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+namespace
+{
+    struct Point
+    {
+        double x;
+        double y;
+    };
+
+    double Dot(const Point& a, const Point& b)
+    {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    // Twice the signed area of abc, positive when abc turns left
+    double Cross(const Point& a, const Point& b, const Point& c)
+    {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    }
+
+    double DistanceSqr(const Point& a, const Point& b)
+    {
+        return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+    }
+
+    std::vector<Point> HullPoints(const Calipers::Points& points, const std::vector<size_t>& hull)
+    {
+        std::vector<Point> result;
+        result.reserve(hull.size());
+
+        for (const auto i : hull)
+        {
+            result.push_back({points[i][0], points[i][1]});
+        }
+
+        return result;
+    }
+}
+
+std::vector<size_t> Calipers::ConvexHull(const Points& points)
+{
+    std::vector<size_t> order(points.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::sort(
+        order.begin(),
+        order.end(),
+        [&points](size_t a, size_t b)
+        {
+            return points[a][0] < points[b][0] || (points[a][0] == points[b][0] && points[a][1] < points[b][1]);
+        }
+    );
+
+    const auto point = [&points](size_t i) -> Point
+    {
+        return {points[i][0], points[i][1]};
+    };
+
+    // Lower chain left to right, then upper chain right to left, dropping
+    // points that do not turn left
+    std::vector<size_t> hull(2 * points.size() + 1);
+    size_t k = 0;
+
+    for (const auto i : order)
+    {
+        while (k >= 2 && Cross(point(hull[k - 2]), point(hull[k - 1]), point(i)) <= 0)
+        {
+            k--;
+        }
+
+        hull[k++] = i;
+    }
+
+    const auto lower = k + 1;
+
+    for (auto it = order.rbegin() + 1; it < order.rend(); it++)
+    {
+        while (k >= lower && Cross(point(hull[k - 2]), point(hull[k - 1]), point(*it)) <= 0)
+        {
+            k--;
+        }
+
+        hull[k++] = *it;
+    }
+
+    // The last point closes the chain onto the first
+    hull.resize(k > 1 ? k - 1 : k);
+
+    if (hull.size() == 2 && points[hull[0]] == points[hull[1]])
+    {
+        hull.resize(1);
+    }
+
+    return hull;
+}
+
+std::pair<size_t, size_t> Calipers::Diameter(const Points& points)
+{
+    const auto hull = ConvexHull(points);
+    const auto m = hull.size();
+
+    if (m < 2)
+    {
+        return {0, 0};
+    }
+
+    const auto h = HullPoints(points, hull);
+
+    auto result = std::make_pair(hull[0], hull[1]);
+    auto maxLengthSqr = DistanceSqr(h[0], h[1]);
+
+    // For each edge, the point furthest from it is antipodal to both of its
+    // ends, and the diameter is an antipodal pair
+    size_t j = 1;
+
+    for (size_t i = 0; i < m && m > 2; i++)
+    {
+        const auto next = (i + 1) % m;
+
+        while (Cross(h[i], h[next], h[(j + 1) % m]) > Cross(h[i], h[next], h[j]))
+        {
+            j = (j + 1) % m;
+        }
+
+        for (const auto a : {i, next})
+        {
+            const auto lengthSqr = DistanceSqr(h[a], h[j]);
+
+            if (lengthSqr > maxLengthSqr)
+            {
+                maxLengthSqr = lengthSqr;
+                result = std::make_pair(hull[a], hull[j]);
+            }
+        }
+    }
+
+    if (result.second < result.first)
+    {
+        std::swap(result.first, result.second);
+    }
+
+    return result;
+}
+
+float Calipers::MinAreaRotation(const Points& points)
+{
+    return Rotation(points, true);
+}
+
+float Calipers::MinHeightRotation(const Points& points)
+{
+    return Rotation(points, false);
+}
+
+float Calipers::Rotation(const Points& points, bool minArea)
+{
+    const auto h = HullPoints(points, ConvexHull(points));
+    const auto m = h.size();
+
+    if (m < 2)
+    {
+        return 0;
+    }
+
+    const auto next = [m](size_t i)
+    {
+        return (i + 1) % m;
+    };
+
+    auto minValue = DBL_MAX;
+    auto rotation = 0.0;
+
+    // Furthest along the edge, furthest across it and furthest back along it
+    size_t right = 0;
+    size_t top = 0;
+    size_t left = 0;
+
+    for (size_t i = 0; i < m; i++)
+    {
+        const auto length = std::sqrt(DistanceSqr(h[i], h[next(i)]));
+        const auto e = Point{(h[next(i)].x - h[i].x) / length, (h[next(i)].y - h[i].y) / length};
+        const auto n = Point{-e.y, e.x};
+
+        if (i == 0)
+        {
+            for (size_t j = 0; j < m; j++)
+            {
+                right = Dot(h[j], e) > Dot(h[right], e) ? j : right;
+                top = Dot(h[j], n) > Dot(h[top], n) ? j : top;
+                left = Dot(h[j], e) < Dot(h[left], e) ? j : left;
+            }
+        }
+
+        while (Dot(h[next(right)], e) > Dot(h[right], e))
+        {
+            right = next(right);
+        }
+
+        while (Dot(h[next(top)], n) > Dot(h[top], n))
+        {
+            top = next(top);
+        }
+
+        while (Dot(h[next(left)], e) < Dot(h[left], e))
+        {
+            left = next(left);
+        }
+
+        const auto width = Dot(h[right], e) - Dot(h[left], e);
+        const auto height = Dot(h[top], n) - Dot(h[i], n);
+
+        const auto value = minArea ? width * height : height;
+
+        if (value < minValue)
+        {
+            minValue = value;
+
+            // Turns the edge onto x, or onto y when it is the longer side
+            rotation = -std::atan2(e.y, e.x) + (minArea && width > height ? M_PI / 2 : 0);
+        }
+    }
+
+    return (float)rotation;
+}
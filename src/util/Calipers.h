@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "MeshDef.h"
+
+// Measures of a set of points taken on their convex hull by rotating
+// calipers, each in time linear in the size of the hull once it is built.
+class Calipers
+{
+public:
+    typedef std::vector<Mesh::TexCoord2D> Points;
+
+    // Indices of the corners of the convex hull, counter-clockwise, without
+    // duplicate or collinear points
+    static std::vector<size_t> ConvexHull(const Points& points);
+
+    // Indices of the two points furthest apart
+    static std::pair<size_t, size_t> Diameter(const Points& points);
+
+    // Counter-clockwise rotation that leaves the points with the bounding
+    // box of least area, its longer side along y
+    static float MinAreaRotation(const Points& points);
+
+    // Counter-clockwise rotation that leaves the points with the bounding
+    // box of least height
+    static float MinHeightRotation(const Points& points);
+
+private:
+    static float Rotation(const Points& points, bool minArea);
+};
@@ -0,0 +1,101 @@
+//
+//  FaceFrames.cpp
+//  LSCM
+//
+
+#include "FaceFrames.h"
+
+#include <array>
+#include <cmath>
+
+FaceFrames::FaceFrames()
+{
+}
+
+void FaceFrames::build(const Mesh* mesh)
+{
+    const auto numFaces = (std::ptrdiff_t)mesh->n_faces();
+
+    _x1.resize(numFaces);
+    _x2.resize(numFaces);
+    _y2.resize(numFaces);
+    _area.resize(numFaces);
+
+    // Edges from the first vertex are gathered through the mesh, then
+    // reduced to frames in a branch-free loop over contiguous arrays
+    std::array<std::vector<float>, 6> edges;
+
+    for (auto& edge : edges)
+    {
+        edge.resize(numFaces);
+    }
+
+    #pragma omp parallel for
+    for (std::ptrdiff_t f = 0; f < numFaces; f++)
+    {
+        Mesh::Point v[3];
+
+        auto i = 0;
+        auto fv_it = mesh->cfv_begin(Mesh::FaceHandle((int)f)), fv_end = mesh->cfv_end(Mesh::FaceHandle((int)f));
+        for (; fv_it != fv_end; fv_it++, i++)
+        {
+            v[i] = mesh->point(*fv_it);
+        }
+
+        const auto v10 = v[1] - v[0];
+        const auto v20 = v[2] - v[0];
+
+        for (i = 0; i < 3; i++)
+        {
+            edges[i][f] = v10[i];
+            edges[i + 3][f] = v20[i];
+        }
+    }
+
+    const auto* ax = edges[0].data();
+    const auto* ay = edges[1].data();
+    const auto* az = edges[2].data();
+    const auto* bx = edges[3].data();
+    const auto* by = edges[4].data();
+    const auto* bz = edges[5].data();
+
+    auto* x1 = _x1.data();
+    auto* x2 = _x2.data();
+    auto* y2 = _y2.data();
+    auto* area = _area.data();
+
+    #pragma omp parallel for simd
+    for (std::ptrdiff_t f = 0; f < numFaces; f++)
+    {
+        const auto cx = ay[f] * bz[f] - az[f] * by[f];
+        const auto cy = az[f] * bx[f] - ax[f] * bz[f];
+        const auto cz = ax[f] * by[f] - ay[f] * bx[f];
+
+        const auto length = std::sqrt(ax[f] * ax[f] + ay[f] * ay[f] + az[f] * az[f]);
+        const auto cross = std::sqrt(cx * cx + cy * cy + cz * cz);
+
+        x1[f] = length;
+        x2[f] = (ax[f] * bx[f] + ay[f] * by[f] + az[f] * bz[f]) / length;
+        y2[f] = cross / length;
+        area[f] = cross * 0.5f;
+    }
+}
+
+size_t FaceFrames::size() const
+{
+    return _x1.size();
+}
+
+void FaceFrames::project(const Mesh::FaceHandle& face, Mesh::Point* pv) const
+{
+    const auto f = face.idx();
+
+    pv[0] = Mesh::Point(0, 0, 0);
+    pv[1] = Mesh::Point(_x1[f], 0, 0);
+    pv[2] = Mesh::Point(_x2[f], _y2[f], 0);
+}
+
+float FaceFrames::area(const Mesh::FaceHandle& face) const
+{
+    return _area[face.idx()];
+}
@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include <vector>
+
+#include "MeshDef.h"
+
+// Local 2D frame of every face of a mesh, as a structure of arrays indexed
+// by face. Each face is laid out isometrically with its first vertex at the
+// origin and its second on the x axis, so it is kept as (x1, 0), (x2, y2).
+class FaceFrames
+{
+private:
+    std::vector<float> _x1;
+    std::vector<float> _x2;
+    std::vector<float> _y2;
+    std::vector<float> _area;
+
+public:
+    FaceFrames();
+
+    void build(const Mesh* mesh);
+
+    size_t size() const;
+
+    // Vertices of the face in its frame, in circulation order
+    void project(const Mesh::FaceHandle& face, Mesh::Point* pv) const;
+
+    float area(const Mesh::FaceHandle& face) const;
+};
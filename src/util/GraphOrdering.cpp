@@ -0,0 +1,134 @@
+//
+//  GraphOrdering.cpp
+//  LSCM
+//
+//  Referenced:
+//  Computer Solution of Large Sparse Positive Definite Systems - George and Liu
+//
+
+#include "GraphOrdering.h"
+
+#include <algorithm>
+
+const size_t UNVISITED = (size_t)-1;
+
+// Searches for a pseudo-peripheral vertex at most this many times
+const int PERIPHERAL_SEARCHES = 4;
+
+std::vector<size_t> GraphOrdering::ReverseCuthillMcKee(const std::vector<size_t>& offsets, const std::vector<size_t>& adjacency)
+{
+    const auto numVertices = offsets.size() - 1;
+
+    const auto degree = [&](size_t vertex)
+    {
+        return offsets[vertex + 1] - offsets[vertex];
+    };
+
+    std::vector<size_t> order;
+    order.reserve(numVertices);
+
+    std::vector<bool> visited(numVertices, false);
+    std::vector<size_t> levels(numVertices, UNVISITED);
+    std::vector<size_t> neighbours;
+
+    // Every component starts from its own peripheral vertex, so each is
+    // laid out from one end to the other
+    for (size_t seed = 0; seed < numVertices; seed++)
+    {
+        if (visited[seed])
+        {
+            continue;
+        }
+
+        const auto start = PeripheralVertex(offsets, adjacency, seed, levels);
+
+        auto head = order.size();
+        order.push_back(start);
+        visited[start] = true;
+
+        for (; head < order.size(); head++)
+        {
+            const auto vertex = order[head];
+
+            neighbours.clear();
+
+            for (auto i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+            {
+                if (!visited[adjacency[i]])
+                {
+                    neighbours.push_back(adjacency[i]);
+                    visited[adjacency[i]] = true;
+                }
+            }
+
+            std::sort(neighbours.begin(), neighbours.end(), [&](size_t a, size_t b) { return degree(a) < degree(b); });
+
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+
+    std::vector<size_t> index(numVertices);
+
+    for (size_t i = 0; i < numVertices; i++)
+    {
+        index[order[i]] = numVertices - 1 - i;
+    }
+
+    return index;
+}
+
+// Walks to the far end of the component of start, restarting the search from
+// the furthest vertex of least degree until the depth stops growing
+size_t GraphOrdering::PeripheralVertex(const std::vector<size_t>& offsets, const std::vector<size_t>& adjacency, size_t start, std::vector<size_t>& levels)
+{
+    std::vector<size_t> queue;
+    auto vertex = start;
+    auto depth = (size_t)0;
+
+    for (auto search = 0; search < PERIPHERAL_SEARCHES; search++)
+    {
+        queue.clear();
+        queue.push_back(vertex);
+        levels[vertex] = 0;
+
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            const auto current = queue[head];
+
+            for (auto i = offsets[current]; i < offsets[current + 1]; i++)
+            {
+                if (levels[adjacency[i]] == UNVISITED)
+                {
+                    levels[adjacency[i]] = levels[current] + 1;
+                    queue.push_back(adjacency[i]);
+                }
+            }
+        }
+
+        const auto last = levels[queue.back()];
+        auto next = queue.back();
+
+        for (const auto candidate : queue)
+        {
+            if (levels[candidate] == last && offsets[candidate + 1] - offsets[candidate] < offsets[next + 1] - offsets[next])
+            {
+                next = candidate;
+            }
+        }
+
+        for (const auto visited : queue)
+        {
+            levels[visited] = UNVISITED;
+        }
+
+        if (search > 0 && last <= depth)
+        {
+            break;
+        }
+
+        depth = last;
+        vertex = next;
+    }
+
+    return vertex;
+}
@@ -0,0 +1,20 @@
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Orderings of the vertices of an undirected graph, given as adjacency lists
+// in compressed form: the neighbours of vertex i are adjacency[offsets[i]]
+// up to adjacency[offsets[i + 1]].
+class GraphOrdering
+{
+public:
+    // Reverse Cuthill-McKee, which keeps neighbours close in the order so
+    // sparse products over the graph touch memory close together. Returns
+    // the new index of every vertex.
+    static std::vector<size_t> ReverseCuthillMcKee(const std::vector<size_t>& offsets, const std::vector<size_t>& adjacency);
+
+private:
+    static size_t PeripheralVertex(const std::vector<size_t>& offsets, const std::vector<size_t>& adjacency, size_t start, std::vector<size_t>& levels);
+};
@@ -0,0 +1,107 @@
+//
+//  IntrinsicKey.cpp
+//  LSCM
+//
+
+#include "IntrinsicKey.h"
+
+#include <cfloat>
+#include <cmath>
+#include <map>
+
+// Largest difference between matching edges, relative to the mean edge
+const double LENGTH_TOLERANCE = 0.001;
+
+// Steps per doubling of the mean edge length in the hash
+const double SCALE_STEPS = 256.0;
+
+IntrinsicKey::IntrinsicKey()
+: numVertices(0)
+, meanLength(0)
+, hash(0)
+{
+}
+
+bool IntrinsicKey::matches(const IntrinsicKey& other) const
+{
+    if (hash != other.hash || numVertices != other.numVertices || faces != other.faces || lengths.size() != other.lengths.size())
+    {
+        return false;
+    }
+
+    const auto tolerance = LENGTH_TOLERANCE * meanLength;
+
+    for (auto i = 0; i < lengths.size(); i++)
+    {
+        if (!(std::abs((double)lengths[i] - other.lengths[i]) <= tolerance))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+IntrinsicKey IntrinsicKey::Build(const Mesh* mesh, const FaceList& faces, const VertexList& vertices)
+{
+    IntrinsicKey key;
+    key.numVertices = (uint32_t)vertices.size();
+
+    std::map<Mesh::VertexHandle, uint32_t> local;
+
+    for (const auto& vertex : vertices)
+    {
+        const auto index = (uint32_t)local.size();
+        local[vertex] = index;
+    }
+
+    key.faces.reserve(faces.size() * 3);
+    key.lengths.reserve(faces.size() * 3);
+
+    auto total = 0.0;
+
+    Mesh::VertexHandle handles[3];
+
+    for (const auto& face : faces)
+    {
+        auto i = 0;
+        auto fv_it = mesh->cfv_begin(face), fv_end = mesh->cfv_end(face);
+        for (; fv_it != fv_end && i < 3; fv_it++, i++)
+        {
+            handles[i] = *fv_it;
+            key.faces.push_back(local.at(*fv_it));
+        }
+
+        for (i = 0; i < 3; i++)
+        {
+            const auto length = (mesh->point(handles[(i + 1) % 3]) - mesh->point(handles[i])).length();
+
+            key.lengths.push_back(length);
+            total += length;
+        }
+    }
+
+    key.meanLength = key.lengths.empty() ? 0 : total / key.lengths.size();
+
+    // FNV-1a, as for MeshUtil::TopologyHash
+    uint64_t hash = 14695981039346656037ull;
+
+    const auto combine = [&hash](uint64_t value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    combine(key.numVertices);
+    combine(faces.size());
+    combine((uint64_t)std::llround(std::log2(std::max(key.meanLength, DBL_MIN)) * SCALE_STEPS));
+
+    for (const auto index : key.faces)
+    {
+        combine(index);
+    }
+
+    key.hash = hash;
+
+    return key;
+}
@@ -0,0 +1,36 @@
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshDef.h"
+
+// Intrinsic geometry of a set of faces: their connectivity over local vertex
+// indices and their edge lengths. It does not change when the faces are
+// moved rigidly, or appear elsewhere in the mesh under other indices, so
+// identical parts share a key.
+struct IntrinsicKey
+{
+    uint32_t numVertices;
+
+    // Local index of each face's vertices, in the order of the vertex list
+    std::vector<uint32_t> faces;
+
+    // Length of each face's edges, from each vertex to the next
+    std::vector<float> lengths;
+    double meanLength;
+
+    // Hash of the connectivity and of the mean length, rounded coarsely
+    // enough that rigidly moved copies share it
+    uint64_t hash;
+
+    IntrinsicKey();
+
+    // Same connectivity, and every edge within a small fraction of the mean
+    // edge length, as float error leaves rigidly moved copies
+    bool matches(const IntrinsicKey& other) const;
+
+    // vertices must hold every vertex of the faces
+    static IntrinsicKey Build(const Mesh* mesh, const FaceList& faces, const VertexList& vertices);
+};
@@ -22,6 +22,33 @@ Mesh::Point MeshUtil::AsPoint(const Mesh::TexCoord2D& t)
     return {t[0], t[1], 1};
 }
 
+size_t MeshUtil::TopologyHash(const Mesh* mesh, const FaceList& faces)
+{
+    // FNV-1a over the face and vertex indices
+    uint64_t hash = 14695981039346656037ull;
+
+    const auto combine = [&hash](uint64_t value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+
+    combine(faces.size());
+
+    for (const auto& face : faces)
+    {
+        combine(face.idx());
+
+        auto fv_it = mesh->cfv_begin(face), fv_end = mesh->cfv_end(face);
+        for (; fv_it != fv_end; fv_it++)
+        {
+            combine(fv_it->idx());
+        }
+    }
+
+    return (size_t)hash;
+}
+
 MeshPtr MeshUtil::ReadMesh(const std::string& path, bool exitOnFail)
 {
     auto mesh = std::make_unique<Mesh>();
@@ -24,6 +24,9 @@ public:
     template<typename T>
     static void Unique(std::vector<T>& list);
 
+    // Hash of the faces' vertex indices, in order
+    static size_t TopologyHash(const Mesh* mesh, const FaceList& faces);
+
     static MeshPtr ReadMesh(const std::string& path, bool exitOnFail = false);
     static bool Write(const std::string& path, MeshPtr const& mesh);
     static bool Write(const std::string& path, const Mesh* mesh);
@@ -4,6 +4,8 @@
 
 #include "VizUtil.h"
 
+#include "Calipers.h"
+
 #include <CImg.h>
 
 using namespace cimg_library;
@@ -118,35 +120,24 @@ bool VizUtil::DrawChart(const std::string& path, MeshPtr const& mesh, const Char
         image.draw_circle(uv[0], uv[1], 2, ColorPoint, 1);
     }
 
-    const auto& perimeter = chart.perimeter();
+    Calipers::Points perimeter;
 
-    auto diameter = std::array<int, 2>{0, 0};
-    auto maxLengthSqr = 0.0;
+    for (const auto& vertex : chart.perimeter())
+    {
+        perimeter.push_back(mesh->property(texCoords, vertex));
+    }
 
-    for (auto i = 0; i < perimeter.size(); i++)
+    if (!perimeter.empty())
     {
-        const auto& pi = mesh->property(texCoords, perimeter[i]);
+        const auto diameter = Calipers::Diameter(perimeter);
 
-        for (auto j = i + 1; j < perimeter.size(); j++)
-        {
-            const auto& pj = mesh->property(texCoords, perimeter[j]);
+        const auto p = perimeter[diameter.first] * image.width();
+        const auto q = perimeter[diameter.second] * image.width();
 
-            auto lengthSqr = (pi - pj).sqrnorm();
-            if (lengthSqr > maxLengthSqr)
-            {
-                maxLengthSqr = lengthSqr;
-                diameter[0] = i;
-                diameter[1] = j;
-            }
-        }
+        image.draw_circle(p[0], p[1], 4, ColorPoint, 1);
+        image.draw_circle(q[0], q[1], 4, ColorPoint, 1);
     }
 
-    const auto p = mesh->property(texCoords, perimeter[diameter[0]]) * image.width();
-    const auto q = mesh->property(texCoords, perimeter[diameter[1]]) * image.width();
-
-    image.draw_circle(p[0], p[1], 4, ColorPoint, 1);
-    image.draw_circle(q[0], q[1], 4, ColorPoint, 1);
-
     image.save_bmp(path.c_str());
 
     return true;
@@ -268,6 +259,25 @@ void VizUtil::DrawAtlasHorizons(const std::string& path, const PackingAtlas& atl
     image.save_bmp(path.c_str());
 }
 
+void VizUtil::DrawOccupancy(const std::string& path, const Bitmap& occupancy)
+{
+    Image image(occupancy.width(), occupancy.height(), 1, 3);
+    image.fill(ColorFill);
+
+    for (auto y = 0; y < occupancy.height(); y++)
+    {
+        for (auto x = 0; x < occupancy.width(); x++)
+        {
+            if (occupancy.get(x, y))
+            {
+                image.draw_point(x, occupancy.height() - 1 - y, ColorLine, 1);
+            }
+        }
+    }
+
+    image.save_bmp(path.c_str());
+}
+
 void VizUtil::DrawAtlasUV(const std::string& path, MeshPtr const& mesh, const std::vector<Chart>& charts)
 {
     Image image(2048, 2048, 1, 3);
@@ -5,6 +5,7 @@
 #include "../charts/Chart.h"
 #include "../packing/PackingChart.h"
 #include "../packing/PackingAtlas.h"
+#include "../packing/Bitmap.h"
 
 class VizUtil
 {
@@ -19,5 +20,7 @@ public:
 
     static void DrawAtlasHorizons(const std::string& path, const PackingAtlas& atlas, const std::vector<PackingChart>& packingCharts);
 
+    static void DrawOccupancy(const std::string& path, const Bitmap& occupancy);
+
     static void DrawAtlasUV(const std::string& path, MeshPtr const& mesh, const std::vector<Chart>& charts);
 };